@@ -0,0 +1,59 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QX11Info>
+#include <QDebug>
+
+#include "atomcache.h"
+#include "x11wrapper.h"
+
+//! The names of the atoms in the order of AtomCache::AtomId
+static const char *atomNames[AtomCache::AtomCount] = {
+    "_NET_ACTIVE_WINDOW",
+    "_NET_CLIENT_LIST",
+    "_NET_CLIENT_LIST_STACKING",
+    "_NET_CLOSE_WINDOW",
+    "_NET_WM_ICON_GEOMETRY",
+    "_NET_WM_NAME",
+    "_NET_WM_PID",
+    "_NET_WM_STATE",
+    "_NET_WM_STATE_HIDDEN",
+    "_NET_WM_STATE_SKIP_TASKBAR",
+    "_NET_WM_WINDOW_TYPE",
+    "_NET_WM_WINDOW_TYPE_CALL",
+    "_NET_WM_WINDOW_TYPE_DESKTOP",
+    "_NET_WM_WINDOW_TYPE_DIALOG",
+    "_NET_WM_WINDOW_TYPE_DOCK",
+    "_NET_WM_WINDOW_TYPE_INPUT",
+    "_NET_WM_WINDOW_TYPE_MENU",
+    "_NET_WM_WINDOW_TYPE_NORMAL",
+    "_NET_WM_WINDOW_TYPE_NOTIFICATION",
+    "UTF8_STRING"
+};
+
+Atom AtomCache::atoms[AtomCache::AtomCount];
+bool AtomCache::initialized = false;
+
+void AtomCache::initialize(Display *display)
+{
+    if (initialized)
+        return;
+
+    if (!X11Wrapper::XInternAtoms(display, const_cast<char **>(atomNames), AtomCount, False, atoms)) {
+        qWarning() << Q_FUNC_INFO << "Unable to intern all the atoms";
+    }
+    initialized = true;
+}
+
+Atom AtomCache::atom(AtomId id)
+{
+    if (!initialized)
+        initialize(QX11Info::display());
+
+    return atoms[id];
+}
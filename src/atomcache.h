@@ -0,0 +1,70 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef ATOMCACHE_H
+#define ATOMCACHE_H
+
+#include <X11/Xlib.h>
+
+/*!
+ * A registry of all the X11 atoms used by Home. The atoms are interned
+ * with a single XInternAtoms() call the first time any of them is needed
+ * and shared by all the components from then on.
+ */
+class AtomCache
+{
+public:
+    enum AtomId {
+        NetActiveWindow,
+        NetClientList,
+        NetClientListStacking,
+        NetCloseWindow,
+        NetWmIconGeometry,
+        NetWmName,
+        NetWmPid,
+        NetWmState,
+        NetWmStateHidden,
+        NetWmStateSkipTaskbar,
+        NetWmWindowType,
+        NetWmWindowTypeCall,
+        NetWmWindowTypeDesktop,
+        NetWmWindowTypeDialog,
+        NetWmWindowTypeDock,
+        NetWmWindowTypeInput,
+        NetWmWindowTypeMenu,
+        NetWmWindowTypeNormal,
+        NetWmWindowTypeNotification,
+        Utf8String,
+        AtomCount
+    };
+
+    /*!
+     * Interns all the atoms in a single round trip. Calling this is
+     * optional; atom() initializes the cache on first use.
+     *
+     * \param display the X display to intern the atoms on
+     */
+    static void initialize(Display *display);
+
+    /*!
+     * Returns the atom identified by \a id.
+     *
+     * \param id the atom to return
+     * \return the atom
+     */
+    static Atom atom(AtomId id);
+
+private:
+    //! The interned atoms, indexed by AtomId
+    static Atom atoms[AtomCount];
+
+    //! Whether the atoms have been interned
+    static bool initialized;
+};
+
+#endif // ATOMCACHE_H
@@ -8,10 +8,11 @@
 
 #include <QProcess>
 #include <QtDeclarative/qdeclarative.h>
-#include <QCryptographicHash>
 #include <QFile>
+#include <sys/stat.h>
 
 #include "desktop.h"
+#include "desktopindex.h"
 
 #define WIDTH_KEY "Desktop Entry/X-MEEGO-APP-HOME-WIDTH"
 #define HEIGHT_KEY "Desktop Entry/X-MEEGO-APP-HOME-HEIGHT"
@@ -19,26 +20,106 @@
 #define ROW_KEY "Desktop Entry/X-MEEGO-APP-HOME-ROW"
 #define COLUMN_KEY "Desktop Entry/X-MEEGO-APP-HOME-COLUMN"
 #define PAGE_KEY "Desktop Entry/X-MEEGO-APP-HOME-PAGE"
+#define STARTUP_WM_CLASS_KEY "Desktop Entry/StartupWMClass"
 
 Desktop::Desktop(const QString &fileName, QObject *parent)
     : QObject(parent)
     , m_filename(fileName)
-    , m_entry(QSharedPointer<MDesktopEntry>(new MDesktopEntry(fileName)))
+    , m_data(load(fileName))
     , m_pid(0)
     , m_wid(0)
     , m_assigned(false)
 {
-    ///Set the id:
-    QFile file(m_filename);
-    file.open(QIODevice::ReadOnly);
-    if(!file.isOpen()) return;
-    QString hash = QCryptographicHash::hash(file.readAll(),QCryptographicHash::Md5);
-    file.close();
-    m_id = hash;
+    DesktopIndex::instance()->addDesktop(this);
+}
+
+Desktop::Desktop(const QString &fileName, const DesktopCache::Entry &data, QObject *parent)
+    : QObject(parent)
+    , m_filename(fileName)
+    , m_data(data)
+    , m_pid(0)
+    , m_wid(0)
+    , m_assigned(false)
+{
+    DesktopIndex::instance()->addDesktop(this);
+}
+
+DesktopCache::Entry Desktop::load(const QString &fileName)
+{
+    // The file is stamped before it is parsed so that a change in between
+    // only makes the cached record look stale on the next start
+    struct stat info;
+    bool stamped = stat(QFile::encodeName(fileName).constData(), &info) == 0;
+    qint64 mtime = stamped ? qint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec : 0;
+    qint64 size = stamped ? info.st_size : 0;
+
+    DesktopCache::Entry data;
+    if (!stamped || !DesktopCache::instance()->find(fileName, mtime, size, &data)) {
+        data = parse(fileName);
+        if (stamped)
+            DesktopCache::instance()->insert(fileName, mtime, size, data);
+    }
+
+    // The id identifies this version of the file without reading it again
+    data.id = createId(fileName, stamped ? info.st_ino : 0, mtime);
+
+    return data;
+}
+
+QString Desktop::createId(const QString &fileName, quint64 inode, qint64 mtime)
+{
+    // 64 bit FNV-1a over the path, the inode and the modification time
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    const uchar *data = reinterpret_cast<const uchar *>(fileName.constData());
+    for (int i = 0; i < fileName.length() * int(sizeof(QChar)); i++)
+        hash = (hash ^ data[i]) * Q_UINT64_C(1099511628211);
+
+    quint64 stamp[2] = { inode, quint64(mtime) };
+    data = reinterpret_cast<const uchar *>(stamp);
+    for (int i = 0; i < int(sizeof(stamp)); i++)
+        hash = (hash ^ data[i]) * Q_UINT64_C(1099511628211);
+
+    return QString::number(hash, 16);
+}
+
+QSharedPointer<MDesktopEntry> Desktop::entry() const
+{
+    if (m_entry.isNull())
+        m_entry = QSharedPointer<MDesktopEntry>(new MDesktopEntry(m_filename));
+    return m_entry;
+}
+
+DesktopCache::Entry Desktop::parse(const QString &fileName)
+{
+    MDesktopEntry desktopEntry(fileName);
+    DesktopCache::Entry data;
+
+    data.type = desktopEntry.type();
+    data.name = desktopEntry.name();
+    data.comment = desktopEntry.comment();
+    data.icon = desktopEntry.icon();
+    data.exec = desktopEntry.exec();
+    data.categories = desktopEntry.categories();
+    data.startupWMClass = desktopEntry.value(STARTUP_WM_CLASS_KEY);
+    data.noDisplay = desktopEntry.noDisplay();
+
+    data.valid = desktopEntry.isValid();
+    QStringList onlyShowIn = desktopEntry.onlyShowIn();
+    if (!onlyShowIn.isEmpty() && !onlyShowIn.contains("X-MEEGO") &&
+        !onlyShowIn.contains("X-MEEGO-HS"))
+        data.valid = false;
+
+    QStringList notShowIn = desktopEntry.notShowIn();
+    if (!notShowIn.isEmpty() && (notShowIn.contains("X-MEEGO") ||
+                                 notShowIn.contains("X-MEEGO-HS")))
+        data.valid = false;
+
+    return data;
 }
 
 Desktop::~Desktop()
 {
+    DesktopIndex::instance()->removeDesktop(this);
 }
 
 QML_DECLARE_TYPE(Desktop);
@@ -16,6 +16,7 @@
 #include <mdesktopentry.h>
 #include <QProcess>
 #include "qticonloader.h"
+#include "desktopcache.h"
 
 #ifdef HAS_CONTENTACTION
 #include "launcheraction.h"
@@ -38,48 +39,51 @@ class Desktop : public QObject
 
 public:
     Desktop(const QString &filename, QObject *parent = 0);
+
+    //! Constructs a desktop entry from fields already loaded with load()
+    Desktop(const QString &filename, const DesktopCache::Entry &data, QObject *parent = 0);
+
+    /*!
+     * Loads the fields of a desktop file from the cache, parsing the file
+     * if it has changed. This may be called from any thread.
+     */
+    static DesktopCache::Entry load(const QString &fileName);
     ~Desktop();
 
     QString id() const {
-        return m_id;
+        return m_data.id;
     }
 
     bool isValid() const {
-        QStringList onlyShowIn = m_entry->onlyShowIn();
-        if (!onlyShowIn.isEmpty() && !onlyShowIn.contains("X-MEEGO") &&
-            !onlyShowIn.contains("X-MEEGO-HS"))
-            return false;
-
-        QStringList notShowIn = m_entry->notShowIn();
-        if (!notShowIn.isEmpty() && (notShowIn.contains("X-MEEGO") ||
-                                     notShowIn.contains("X-MEEGO-HS")))
-            return false;
-
-        return m_entry->isValid();
+        return m_data.valid;
     }
 
     QString type() const {
-        return m_entry->type();
+        return m_data.type;
     }
 
     QString title() const {
-        return m_entry->name();
+        return m_data.name;
     }
 
     QString comment() const {
-        return m_entry->comment();
+        return m_data.comment;
     }
 
     QString icon() const {
-        return QtIconLoader::icon(m_entry->icon());
+        return QtIconLoader::icon(m_data.icon);
     }
 
     QString exec() const {
-        return m_entry->exec();
+        return m_data.exec;
     }
 
     QStringList categories() const {
-        return m_entry->categories();
+        return m_data.categories;
+    }
+
+    QString startupWMClass() const {
+        return m_data.startupWMClass;
     }
 
     QString filename() const {
@@ -106,7 +110,7 @@ public:
     }
 
     bool nodisplay() const {
-        return m_entry->noDisplay();
+        return m_data.noDisplay;
     } 
 
     enum Role {
@@ -137,7 +141,7 @@ public:
         qDebug("Launching %s", qPrintable(cmd));
         QProcess::startDetached(cmd);
 #else
-        LauncherAction action(m_entry);
+        LauncherAction action(entry());
         action.trigger();
 #endif
     }
@@ -145,17 +149,17 @@ public:
 public slots:
 
     QString value(QString key) const {
-        return m_entry->value(key);
+        return entry()->value(key);
     }
 
     bool contains(QString val) const {
-        return m_entry->contains(val);
+        return entry()->contains(val);
     }
 
     bool uninstall() {
-        if (m_entry->type() == "Widget")
+        if (m_data.type == "Widget")
         {
-            return QFile::remove(m_entry->fileName());
+            return QFile::remove(m_filename);
         }
 
         return false;
@@ -172,9 +176,22 @@ signals:
     void nodisplayChanged();
 
 private:
+    //! Returns the parsed desktop entry, parsing the file on first use
+    QSharedPointer<MDesktopEntry> entry() const;
+
+    //! Parses the fields of a desktop file
+    static DesktopCache::Entry parse(const QString &fileName);
+
+    //! Returns an id for a version of a desktop file
+    static QString createId(const QString &fileName, quint64 inode, qint64 mtime);
+
     QString m_filename;
-    QSharedPointer<MDesktopEntry> m_entry;
-    QString m_id;
+
+    //! The desktop entry; only created when a field that isn't cached is needed
+    mutable QSharedPointer<MDesktopEntry> m_entry;
+
+    //! The fields used by the launcher, read from the cache when the file hasn't changed
+    DesktopCache::Entry m_data;
     int m_pid;
     int m_wid;
 
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QLocale>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <stdio.h>
+#include <string.h>
+
+#include "desktopcache.h"
+
+//! Identifies the cache file; "LDEC" in native byte order
+static const quint32 CACHE_MAGIC = 0x4c444543;
+
+//! The version of the record layout; bump whenever the cached fields change
+static const quint32 CACHE_VERSION = 3;
+
+//! The time in milliseconds the changes are collected for before they are written
+static const int SAVE_DELAY = 2000;
+
+//! The fields of a record in the order they are stored
+enum Field {
+    PathField,
+    TypeField,
+    NameField,
+    CommentField,
+    IconField,
+    ExecField,
+    CategoriesField,
+    StartupWMClassField,
+    FieldCount
+};
+
+enum Flag {
+    ValidFlag = 0x1,
+    NoDisplayFlag = 0x2
+};
+
+/*!
+ * The header of the cache file. The UTF-16 name of the locale the names and
+ * comments were localized for follows the header, padded to a multiple of
+ * 8 bytes.
+ */
+struct CacheHeader
+{
+    quint32 magic;
+    quint32 version;
+
+    //! The length of the locale name in UTF-16 code units
+    quint32 localeLength;
+    quint32 reserved;
+};
+
+/*!
+ * The header of a record. The UTF-16 data of the fields follows the header
+ * in the order of the Field enumeration and the record is padded to a
+ * multiple of 8 bytes so that the next header is aligned.
+ */
+struct DesktopCache::Record
+{
+    //! The length of the whole record in bytes
+    quint32 length;
+    quint32 flags;
+    qint64 mtime;
+    qint64 size;
+
+    //! The lengths of the fields in UTF-16 code units
+    quint32 fieldLengths[FieldCount];
+
+    const QChar *fieldData(int index) const
+    {
+        const QChar *data = reinterpret_cast<const QChar *>(this + 1);
+        for (int i = 0; i < index; i++)
+            data += fieldLengths[i];
+        return data;
+    }
+
+    QString field(int index) const
+    {
+        return QString(fieldData(index), fieldLengths[index]);
+    }
+};
+
+static inline int paddedLength(int length)
+{
+    return (length + 7) & ~7;
+}
+
+//! Returns the name of the locale MDesktopEntry localizes the names and comments for
+static QString localeName()
+{
+    return QLocale::system().name();
+}
+
+DesktopCache *DesktopCache::instance()
+{
+    static DesktopCache desktopCache;
+    return &desktopCache;
+}
+
+DesktopCache::DesktopCache()
+    : saveScheduled(false)
+{
+    // Entries may be looked up from worker threads but the saving is done in the main thread
+    moveToThread(QCoreApplication::instance()->thread());
+    saveTimer.moveToThread(QCoreApplication::instance()->thread());
+    saveTimer.setSingleShot(true);
+    saveTimer.setInterval(SAVE_DELAY);
+    connect(&saveTimer, SIGNAL(timeout()), this, SLOT(save()));
+    load();
+}
+
+QString DesktopCache::fileName()
+{
+    QString cacheHome = QFile::decodeName(qgetenv("XDG_CACHE_HOME"));
+    if (cacheHome.isEmpty())
+        cacheHome = QDir::homePath() + "/.cache";
+    return cacheHome + "/lipstick/desktop-entries.cache";
+}
+
+void DesktopCache::load()
+{
+    file.setFileName(fileName());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    qint64 fileSize = file.size();
+    const uchar *data = fileSize >= (qint64)sizeof(CacheHeader) ? file.map(0, fileSize) : 0;
+    if (data == 0) {
+        file.close();
+        return;
+    }
+
+    // The records of another version or written in another locale are all stale
+    const CacheHeader *header = reinterpret_cast<const CacheHeader *>(data);
+    qint64 offset = paddedLength(sizeof(CacheHeader) + header->localeLength * sizeof(QChar));
+    if (header->magic != CACHE_MAGIC || header->version != CACHE_VERSION || offset > fileSize ||
+        QString(reinterpret_cast<const QChar *>(header + 1), header->localeLength) != localeName()) {
+        file.unmap(const_cast<uchar *>(data));
+        file.close();
+        return;
+    }
+
+    // Only the paths are decoded here; the rest of a record is decoded when it is looked up
+    while (offset + (qint64)sizeof(Record) <= fileSize) {
+        const Record *record = reinterpret_cast<const Record *>(data + offset);
+
+        qint64 fieldsLength = 0;
+        for (int i = 0; i < FieldCount; i++)
+            fieldsLength += record->fieldLengths[i];
+
+        // A truncated or corrupt record ends the cache
+        if (record->length != (quint32)paddedLength(sizeof(Record) + fieldsLength * sizeof(QChar)) ||
+            offset + record->length > fileSize)
+            break;
+
+        records.insert(record->field(PathField), record);
+        offset += record->length;
+    }
+}
+
+bool DesktopCache::find(const QString &path, qint64 mtime, qint64 size, Entry *entry)
+{
+    QMutexLocker locker(&mutex);
+
+    QHash<QString, StoredEntry>::const_iterator storedEntry = storedEntries.constFind(path);
+    if (storedEntry != storedEntries.constEnd()) {
+        if (storedEntry->mtime != mtime || storedEntry->size != size)
+            return false;
+
+        *entry = storedEntry->entry;
+        return true;
+    }
+
+    const Record *record = records.value(path);
+    if (record == 0 || record->mtime != mtime || record->size != size)
+        return false;
+
+    usedRecords.insert(path);
+
+    entry->type = record->field(TypeField);
+    entry->name = record->field(NameField);
+    entry->comment = record->field(CommentField);
+    entry->icon = record->field(IconField);
+    entry->exec = record->field(ExecField);
+    entry->categories = record->field(CategoriesField).split(';', QString::SkipEmptyParts);
+    entry->startupWMClass = record->field(StartupWMClassField);
+    entry->valid = record->flags & ValidFlag;
+    entry->noDisplay = record->flags & NoDisplayFlag;
+
+    return true;
+}
+
+void DesktopCache::insert(const QString &path, qint64 mtime, qint64 size, const Entry &entry)
+{
+    QMutexLocker locker(&mutex);
+
+    StoredEntry storedEntry;
+    storedEntry.mtime = mtime;
+    storedEntry.size = size;
+    storedEntry.entry = entry;
+    storedEntries.insert(path, storedEntry);
+
+    scheduleSave();
+}
+
+void DesktopCache::remove(const QString &path)
+{
+    QMutexLocker locker(&mutex);
+
+    bool removed = storedEntries.remove(path) > 0;
+    removed |= records.remove(path) > 0;
+    usedRecords.remove(path);
+
+    if (removed)
+        scheduleSave();
+}
+
+void DesktopCache::scheduleSave()
+{
+    if (!saveScheduled) {
+        saveScheduled = true;
+        QMetaObject::invokeMethod(this, "startSaveTimer", Qt::QueuedConnection);
+    }
+}
+
+void DesktopCache::startSaveTimer()
+{
+    saveTimer.start();
+}
+
+QByteArray DesktopCache::encode(const QString &path, qint64 mtime, qint64 size, const Entry &entry)
+{
+    QString fields[FieldCount];
+    fields[PathField] = path;
+    fields[TypeField] = entry.type;
+    fields[NameField] = entry.name;
+    fields[CommentField] = entry.comment;
+    fields[IconField] = entry.icon;
+    fields[ExecField] = entry.exec;
+    fields[CategoriesField] = entry.categories.join(";");
+    fields[StartupWMClassField] = entry.startupWMClass;
+
+    Record record;
+    memset(&record, 0, sizeof(Record));
+    record.flags = (entry.valid ? ValidFlag : 0) | (entry.noDisplay ? NoDisplayFlag : 0);
+    record.mtime = mtime;
+    record.size = size;
+
+    int fieldsLength = 0;
+    for (int i = 0; i < FieldCount; i++) {
+        record.fieldLengths[i] = fields[i].length();
+        fieldsLength += fields[i].length();
+    }
+    record.length = paddedLength(sizeof(Record) + fieldsLength * sizeof(QChar));
+
+    QByteArray data(record.length, 0);
+    char *p = data.data();
+    memcpy(p, &record, sizeof(Record));
+    p += sizeof(Record);
+    for (int i = 0; i < FieldCount; i++) {
+        memcpy(p, fields[i].constData(), fields[i].length() * sizeof(QChar));
+        p += fields[i].length() * sizeof(QChar);
+    }
+
+    return data;
+}
+
+void DesktopCache::save()
+{
+    // Take a copy of the entries so that the parsing threads aren't blocked
+    // while the file is written. The mapped records stay valid until exit.
+    QMutexLocker locker(&mutex);
+    saveScheduled = false;
+    QHash<QString, const Record *> records = this->records;
+    QSet<QString> usedRecords = this->usedRecords;
+    QHash<QString, StoredEntry> storedEntries = this->storedEntries;
+    locker.unlock();
+
+    QString path = fileName();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    // Write a new file and rename it over the old one; the old one stays mapped until exit
+    QFile newFile(path + ".new");
+    if (!newFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    QString locale = localeName();
+    CacheHeader header;
+    memset(&header, 0, sizeof(CacheHeader));
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.localeLength = locale.length();
+    QByteArray headerData(paddedLength(sizeof(CacheHeader) + locale.length() * sizeof(QChar)), 0);
+    memcpy(headerData.data(), &header, sizeof(CacheHeader));
+    memcpy(headerData.data() + sizeof(CacheHeader), locale.constData(), locale.length() * sizeof(QChar));
+    newFile.write(headerData);
+
+    // The mapped records are copied as they are. Those that haven't been
+    // looked up are only kept if their files still exist.
+    for (QHash<QString, const Record *>::const_iterator record = records.constBegin(); record != records.constEnd(); ++record) {
+        if (storedEntries.contains(record.key()))
+            continue;
+        if (!usedRecords.contains(record.key()) && !QFile::exists(record.key()))
+            continue;
+
+        newFile.write(reinterpret_cast<const char *>(record.value()), record.value()->length);
+    }
+
+    for (QHash<QString, StoredEntry>::const_iterator storedEntry = storedEntries.constBegin(); storedEntry != storedEntries.constEnd(); ++storedEntry)
+        newFile.write(encode(storedEntry.key(), storedEntry->mtime, storedEntry->size, storedEntry->entry));
+
+    bool written = newFile.error() == QFile::NoError;
+    newFile.close();
+
+    if (!written || rename(QFile::encodeName(newFile.fileName()).constData(), QFile::encodeName(path).constData()) != 0) {
+        qWarning("Failed to write the desktop entry cache %s", qPrintable(path));
+        QFile::remove(newFile.fileName());
+    }
+}
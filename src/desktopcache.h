@@ -0,0 +1,148 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef DESKTOPCACHE_H
+#define DESKTOPCACHE_H
+
+#include <QObject>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+
+/*!
+ * A persistent cache of the desktop entry fields the launcher uses. The
+ * cache file holds one record per desktop file, keyed by the path, the
+ * modification time and the size of the file. The file is memory mapped
+ * when the cache is first used and the records are only decoded when they
+ * are looked up, so a desktop file needs to be parsed only when it has
+ * changed since the cache was last written. The names and comments are
+ * localized, so the whole cache is stale when the locale has changed.
+ *
+ * Changes are written back to the cache file a while after the first change
+ * since the last write, so that parsing a whole directory of desktop files
+ * ends up in a single write. The entries may be looked up and stored from
+ * any thread.
+ */
+class DesktopCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! The cached fields of a desktop entry
+    struct Entry
+    {
+        Entry()
+            : valid(false)
+            , noDisplay(false)
+        {}
+
+        //! The id of the file; not cached since it is derived from the path and the stamp
+        QString id;
+        QString type;
+        QString name;
+        QString comment;
+        QString icon;
+        QString exec;
+        QStringList categories;
+        QString startupWMClass;
+
+        //! Whether the entry is valid and shown on MeeGo
+        bool valid;
+        bool noDisplay;
+    };
+
+    //! Returns the DesktopCache instance
+    static DesktopCache *instance();
+
+    /*!
+     * Looks up the entry of a desktop file.
+     *
+     * \param path the absolute path of the desktop file
+     * \param mtime the modification time of the file in nanoseconds
+     * \param size the size of the file in bytes
+     * \param entry the entry to fill in
+     * \return \c true if a record of the file with the same modification time and size was found
+     */
+    bool find(const QString &path, qint64 mtime, qint64 size, Entry *entry);
+
+    /*!
+     * Stores the entry of a desktop file, replacing any previous one.
+     *
+     * \param path the absolute path of the desktop file
+     * \param mtime the modification time of the file in nanoseconds
+     * \param size the size of the file in bytes
+     * \param entry the parsed entry
+     */
+    void insert(const QString &path, qint64 mtime, qint64 size, const Entry &entry);
+
+    /*!
+     * Removes the entry of a desktop file that no longer exists.
+     *
+     * \param path the absolute path of the desktop file
+     */
+    void remove(const QString &path);
+
+private slots:
+    //! Starts the timer for writing the changes; called in the main thread
+    void startSaveTimer();
+
+    //! Writes the records to the cache file
+    void save();
+
+private:
+    DesktopCache();
+
+    //! The header of a record in the cache file
+    struct Record;
+
+    //! An entry stored during this session
+    struct StoredEntry
+    {
+        qint64 mtime;
+        qint64 size;
+        Entry entry;
+    };
+
+    //! Maps the cache file and indexes its records by their paths
+    void load();
+
+    //! Schedules save() to be called unless it already has been; called with the mutex locked
+    void scheduleSave();
+
+    //! Returns the path of the cache file
+    static QString fileName();
+
+    //! Encodes a record of an entry
+    static QByteArray encode(const QString &path, qint64 mtime, qint64 size, const Entry &entry);
+
+    //! The mapped cache file
+    QFile file;
+
+    //! The records of the mapped cache file by their paths
+    QHash<QString, const Record *> records;
+
+    //! The paths of the mapped records that have been looked up during this session
+    QSet<QString> usedRecords;
+
+    //! The entries stored during this session by their paths
+    QHash<QString, StoredEntry> storedEntries;
+
+    //! Whether save() has been scheduled
+    bool saveScheduled;
+
+    //! Timer for writing the changes collected since the last write at once
+    QTimer saveTimer;
+
+    //! Serializes the access from the desktop file parsing threads
+    QMutex mutex;
+};
+
+#endif // DESKTOPCACHE_H
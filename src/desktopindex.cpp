@@ -0,0 +1,236 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QFileInfo>
+#include <QMetaObject>
+
+#include "desktopindex.h"
+#include "desktop.h"
+#include "windowinfo.h"
+
+DesktopIndex *DesktopIndex::instance()
+{
+    static DesktopIndex desktopIndex;
+    return &desktopIndex;
+}
+
+DesktopIndex::DesktopIndex()
+    : desktopsChangedScheduled(false)
+{
+}
+
+QStringList DesktopIndex::classKeys(const Desktop *desktop)
+{
+    QStringList keys;
+
+    QString startupWMClass = desktop->startupWMClass();
+    if (!startupWMClass.isEmpty())
+        keys << startupWMClass.toLower();
+
+    QString executable = desktop->exec().section(' ', 0, 0, QString::SectionSkipEmpty);
+    if (!executable.isEmpty())
+        keys << QFileInfo(executable).fileName().toLower();
+
+    keys << QFileInfo(desktop->filename()).completeBaseName().toLower();
+
+    return keys;
+}
+
+void DesktopIndex::addDesktop(Desktop *desktop)
+{
+    foreach (const QString &key, classKeys(desktop)) {
+        if (!desktopsByClass.contains(key))
+            desktopsByClass.insert(key, desktop);
+    }
+
+    // Windows linked through their process may match the new entry by their WM_CLASS
+    foreach (const WindowInfo *window, desktopsByWindow.keys()) {
+        if (desktopsByWindow.value(window) != desktop && desktopForClass(window) == desktop)
+            setDesktop(window, desktop);
+    }
+
+    linkUnmatchedWindows();
+    scheduleDesktopsChanged();
+}
+
+void DesktopIndex::removeDesktop(Desktop *desktop)
+{
+    foreach (const QString &key, classKeys(desktop)) {
+        if (desktopsByClass.value(key) == desktop)
+            desktopsByClass.remove(key);
+    }
+
+    QHash<int, Desktop *>::iterator i = desktopsByPid.begin();
+    while (i != desktopsByPid.end()) {
+        if (i.value() == desktop)
+            i = desktopsByPid.erase(i);
+        else
+            ++i;
+    }
+
+    // The windows of the entry may match another one
+    QList<const WindowInfo *> linkedWindows = desktopsByWindow.keys(desktop);
+    foreach (const WindowInfo *window, linkedWindows)
+        desktopsByWindow.remove(window);
+    foreach (const WindowInfo *window, linkedWindows)
+        linkWindow(window);
+
+    scheduleDesktopsChanged();
+}
+
+void DesktopIndex::addWindow(const WindowInfo *window)
+{
+    if (windowPids.contains(window))
+        return;
+
+    connect(window, SIGNAL(classChanged()), this, SLOT(relinkWindow()));
+    connect(window, SIGNAL(pidChanged()), this, SLOT(relinkWindow()));
+    indexWindow(window);
+}
+
+void DesktopIndex::removeWindow(const WindowInfo *window)
+{
+    if (!windowPids.contains(window))
+        return;
+
+    disconnect(window, 0, this, 0);
+    unindexWindow(window);
+}
+
+void DesktopIndex::relinkWindow()
+{
+    const WindowInfo *window = static_cast<const WindowInfo *>(sender());
+    if (!windowPids.contains(window))
+        return;
+
+    unindexWindow(window);
+    indexWindow(window);
+    scheduleDesktopsChanged();
+}
+
+void DesktopIndex::indexWindow(const WindowInfo *window)
+{
+    windowPids.insert(window, window->pid());
+    if (window->pid() > 0)
+        windowsByPid.insert(window->pid(), window);
+
+    linkWindow(window);
+
+    // A window matched by its WM_CLASS links the unmatched windows of its process too
+    Desktop *desktop = desktopsByPid.value(window->pid());
+    if (window->pid() > 0 && desktop != NULL) {
+        bool linked = false;
+        foreach (const WindowInfo *processWindow, windowsByPid.values(window->pid())) {
+            if (!desktopsByWindow.contains(processWindow)) {
+                setDesktop(processWindow, desktop);
+                linked = true;
+            }
+        }
+
+        if (linked)
+            scheduleDesktopsChanged();
+    }
+}
+
+void DesktopIndex::unindexWindow(const WindowInfo *window)
+{
+    // The process ID of the window may have changed since it was indexed
+    int pid = windowPids.take(window);
+    if (pid > 0) {
+        windowsByPid.remove(pid, window);
+
+        // The process ID may get reused by another application
+        if (!windowsByPid.contains(pid))
+            desktopsByPid.remove(pid);
+    }
+
+    Desktop *desktop = desktopsByWindow.take(window);
+    if (desktop != NULL)
+        updateDesktopWindow(desktop);
+}
+
+Desktop *DesktopIndex::desktopFor(const WindowInfo *window) const
+{
+    return desktopsByWindow.value(window);
+}
+
+Desktop *DesktopIndex::desktopForClass(const WindowInfo *window) const
+{
+    Desktop *desktop = NULL;
+    if (!window->windowClass().isEmpty())
+        desktop = desktopsByClass.value(window->windowClass().toLower());
+    if (desktop == NULL && !window->windowInstance().isEmpty())
+        desktop = desktopsByClass.value(window->windowInstance().toLower());
+    return desktop;
+}
+
+void DesktopIndex::linkWindow(const WindowInfo *window)
+{
+    Desktop *desktop = desktopForClass(window);
+
+    if (window->pid() > 0) {
+        if (desktop != NULL) {
+            if (!desktopsByPid.contains(window->pid()))
+                desktopsByPid.insert(window->pid(), desktop);
+        } else {
+            desktop = desktopsByPid.value(window->pid());
+        }
+    }
+
+    setDesktop(window, desktop);
+}
+
+void DesktopIndex::linkUnmatchedWindows()
+{
+    // Two passes so that the windows matched by their WM_CLASS in the
+    // first one link the other windows of their processes in the second
+    for (int pass = 0; pass < 2; pass++) {
+        foreach (const WindowInfo *window, windowPids.keys()) {
+            if (!desktopsByWindow.contains(window))
+                linkWindow(window);
+        }
+    }
+}
+
+void DesktopIndex::setDesktop(const WindowInfo *window, Desktop *desktop)
+{
+    Desktop *previousDesktop = desktopsByWindow.value(window);
+    if (desktop != NULL)
+        desktopsByWindow.insert(window, desktop);
+    else
+        desktopsByWindow.remove(window);
+
+    if (previousDesktop != NULL && previousDesktop != desktop)
+        updateDesktopWindow(previousDesktop);
+
+    if (desktop != NULL) {
+        desktop->setPid(window->pid());
+        desktop->setWid(window->window());
+    }
+}
+
+void DesktopIndex::updateDesktopWindow(Desktop *desktop)
+{
+    const WindowInfo *window = desktopsByWindow.key(desktop, NULL);
+    desktop->setPid(window != NULL ? window->pid() : 0);
+    desktop->setWid(window != NULL ? window->window() : 0);
+}
+
+void DesktopIndex::scheduleDesktopsChanged()
+{
+    if (!desktopsChangedScheduled) {
+        desktopsChangedScheduled = true;
+        QMetaObject::invokeMethod(this, "emitDesktopsChanged", Qt::QueuedConnection);
+    }
+}
+
+void DesktopIndex::emitDesktopsChanged()
+{
+    desktopsChangedScheduled = false;
+    emit desktopsChanged();
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef DESKTOPINDEX_H
+#define DESKTOPINDEX_H
+
+#include <QObject>
+#include <QHash>
+#include <QStringList>
+
+class Desktop;
+class WindowInfo;
+
+/*!
+ * A process wide index linking windows to the desktop entries of the
+ * applications they belong to. Desktop entries are indexed by their
+ * StartupWMClass, executable name and file name so that a window can be
+ * matched by its WM_CLASS. Once a window of a process has been matched
+ * the process ID is remembered too, so that the other windows of the
+ * process are matched even if they don't have a matching WM_CLASS.
+ *
+ * The links are maintained as windows and desktop entries are added and
+ * removed, so looking up the desktop entry of a window has no side effects.
+ * The pid and wid of a desktop entry are those of a window linked to it, or
+ * zero if there is none.
+ */
+class DesktopIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Returns the DesktopIndex instance
+    static DesktopIndex *instance();
+
+    //! Adds a desktop entry to the index and links the windows whose WM_CLASS matches it or that are unmatched
+    void addDesktop(Desktop *desktop);
+
+    //! Removes a desktop entry from the index and relinks its windows
+    void removeDesktop(Desktop *desktop);
+
+    /*!
+     * Adds a window to the index and links it to its desktop entry. The
+     * window is relinked whenever its WM_CLASS or process ID changes.
+     */
+    void addWindow(const WindowInfo *window);
+
+    //! Removes a window from the index
+    void removeWindow(const WindowInfo *window);
+
+    /*!
+     * Returns the desktop entry of the application \a window belongs to.
+     *
+     * \param window the window to look up
+     * \return the desktop entry or 0 if none matches
+     */
+    Desktop *desktopFor(const WindowInfo *window) const;
+
+signals:
+    //! Emitted (at most once per event loop iteration) when desktop entries or their links to windows have changed
+    void desktopsChanged();
+
+private slots:
+    void emitDesktopsChanged();
+
+    //! Relinks the sending window after its WM_CLASS or process ID has changed
+    void relinkWindow();
+
+private:
+    DesktopIndex();
+
+    //! Returns the WM_CLASS like names a desktop entry is known by
+    static QStringList classKeys(const Desktop *desktop);
+
+    //! Returns the desktop entry whose class keys match the WM_CLASS of a window
+    Desktop *desktopForClass(const WindowInfo *window) const;
+
+    //! Indexes a window by its current process ID and links it
+    void indexWindow(const WindowInfo *window);
+
+    //! Removes a window from the index by the process ID it was indexed with
+    void unindexWindow(const WindowInfo *window);
+
+    //! Links a window to its desktop entry by its WM_CLASS or its process
+    void linkWindow(const WindowInfo *window);
+
+    //! Links the windows without a desktop entry, if possible
+    void linkUnmatchedWindows();
+
+    //! Sets the desktop entry a window is linked to
+    void setDesktop(const WindowInfo *window, Desktop *desktop);
+
+    //! Sets the pid and wid of a desktop entry from a window still linked to it
+    void updateDesktopWindow(Desktop *desktop);
+
+    //! Schedules desktopsChanged() to be emitted
+    void scheduleDesktopsChanged();
+
+    //! Desktop entries by lower case class keys
+    QHash<QString, Desktop *> desktopsByClass;
+
+    //! Desktop entries by the process IDs of the windows matched to them
+    QHash<int, Desktop *> desktopsByPid;
+
+    //! The windows by their process IDs
+    QMultiHash<int, const WindowInfo *> windowsByPid;
+
+    //! All the windows in the index and the process IDs they were indexed by
+    QHash<const WindowInfo *, int> windowPids;
+
+    //! The desktop entries the windows are linked to
+    QHash<const WindowInfo *, Desktop *> desktopsByWindow;
+
+    //! Whether desktopsChanged() has been scheduled
+    bool desktopsChangedScheduled;
+};
+
+#endif // DESKTOPINDEX_H
@@ -0,0 +1,272 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QX11Info>
+
+#include "glxtexturepixmap.h"
+#include "x11wrapper.h"
+#include "xerrortrap.h"
+#include <GL/gl.h>
+#include <GL/glx.h>
+
+#ifndef GLX_EXT_texture_from_pixmap
+#define GLX_BIND_TO_TEXTURE_RGB_EXT 0x20D0
+#define GLX_BIND_TO_TEXTURE_RGBA_EXT 0x20D1
+#define GLX_BIND_TO_TEXTURE_TARGETS_EXT 0x20D3
+#define GLX_Y_INVERTED_EXT 0x20D4
+#define GLX_TEXTURE_FORMAT_EXT 0x20D5
+#define GLX_TEXTURE_TARGET_EXT 0x20D6
+#define GLX_TEXTURE_FORMAT_RGB_EXT 0x20D9
+#define GLX_TEXTURE_FORMAT_RGBA_EXT 0x20DA
+#define GLX_TEXTURE_2D_BIT_EXT 0x00000002
+#define GLX_TEXTURE_2D_EXT 0x20DC
+#define GLX_FRONT_LEFT_EXT 0x20DE
+#endif
+
+typedef void (*BindTexImageFunction)(Display *display, GLXDrawable drawable, int buffer, const int *attributes);
+typedef void (*ReleaseTexImageFunction)(Display *display, GLXDrawable drawable, int buffer);
+
+static BindTexImageFunction bindTexImage = NULL;
+static ReleaseTexImageFunction releaseTexImage = NULL;
+
+//! A framebuffer configuration that can be bound to a texture
+struct TextureConfig
+{
+    TextureConfig()
+        : config(0)
+        , yInverted(false)
+    {}
+
+    GLXFBConfig config;
+    bool yInverted;
+};
+
+//! The framebuffer configurations by pixmap depth; an empty configuration disables the depth
+static QHash<int, TextureConfig> textureConfigs;
+
+//! Returns the framebuffer configuration for binding pixmaps of the given depth; looked up once per depth
+static TextureConfig textureConfig(int depth)
+{
+    if (textureConfigs.contains(depth)) {
+        return textureConfigs.value(depth);
+    }
+
+    Display *display = QX11Info::display();
+    int attributes[] = {
+        depth == 32 ? GLX_BIND_TO_TEXTURE_RGBA_EXT : GLX_BIND_TO_TEXTURE_RGB_EXT, True,
+        GLX_DRAWABLE_TYPE, GLX_PIXMAP_BIT,
+        GLX_BIND_TO_TEXTURE_TARGETS_EXT, GLX_TEXTURE_2D_BIT_EXT,
+        GLX_DOUBLEBUFFER, False,
+        None
+    };
+
+    TextureConfig textureConfig;
+    int count = 0;
+    GLXFBConfig *configs = glXChooseFBConfig(display, QX11Info::appScreen(), attributes, &count);
+    for (int i = 0; i < count && textureConfig.config == 0; i++) {
+        XVisualInfo *visualInfo = glXGetVisualFromFBConfig(display, configs[i]);
+        if (visualInfo != NULL) {
+            if (visualInfo->depth == depth) {
+                int yInverted = 0;
+                glXGetFBConfigAttrib(display, configs[i], GLX_Y_INVERTED_EXT, &yInverted);
+                textureConfig.config = configs[i];
+                textureConfig.yInverted = yInverted;
+            }
+            XFree(visualInfo);
+        }
+    }
+    if (configs != NULL) {
+        XFree(configs);
+    }
+
+    textureConfigs.insert(depth, textureConfig);
+    return textureConfig;
+}
+
+//! Textures destroyed while their GL context wasn't current, by context; deleted when it is current again
+static QHash<GLXContext, QVector<GLuint> > orphanedTextures;
+
+//! Deletes the orphaned textures of the current GL context
+static void deleteOrphanedTextures()
+{
+    GLXContext context = glXGetCurrentContext();
+    if (context == NULL || !orphanedTextures.contains(context)) {
+        return;
+    }
+
+    QVector<GLuint> textures = orphanedTextures.take(context);
+    glDeleteTextures(textures.count(), textures.constData());
+}
+
+struct GLXTexturePixmap::Private
+{
+    Private()
+        : pixmap(0)
+        , glxPixmap(0)
+        , context(NULL)
+        , texture(0)
+        , yInverted(false)
+        , hasAlpha(false)
+    {}
+
+    Pixmap pixmap;
+    GLXPixmap glxPixmap;
+
+    //! The GL context the texture was created in
+    GLXContext context;
+
+    GLuint texture;
+    bool yInverted;
+    bool hasAlpha;
+};
+
+bool GLXTexturePixmap::isSupported()
+{
+    static int supported = -1;
+    if (supported == -1) {
+        supported = 0;
+        if (qgetenv("LIPSTICK_NO_TEXTURE_FROM_PIXMAP").isEmpty()) {
+            QList<QByteArray> extensions = QByteArray(glXQueryExtensionsString(QX11Info::display(), QX11Info::appScreen())).split(' ');
+            if (extensions.contains("GLX_EXT_texture_from_pixmap")) {
+                bindTexImage = (BindTexImageFunction)glXGetProcAddressARB((const GLubyte *)"glXBindTexImageEXT");
+                releaseTexImage = (ReleaseTexImageFunction)glXGetProcAddressARB((const GLubyte *)"glXReleaseTexImageEXT");
+                supported = bindTexImage != NULL && releaseTexImage != NULL;
+            }
+        }
+    }
+
+    return supported;
+}
+
+GLXTexturePixmap::GLXTexturePixmap(Qt::HANDLE pixmap, int depth)
+    : d(new Private)
+{
+    d->pixmap = pixmap;
+    if (pixmap == 0 || !isSupported()) {
+        return;
+    }
+
+    TextureConfig config = textureConfig(depth);
+    if (config.config == 0) {
+        return;
+    }
+
+    d->yInverted = config.yInverted;
+    d->hasAlpha = depth == 32;
+    int attributes[] = {
+        GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
+        GLX_TEXTURE_FORMAT_EXT, d->hasAlpha ? GLX_TEXTURE_FORMAT_RGBA_EXT : GLX_TEXTURE_FORMAT_RGB_EXT,
+        None
+    };
+
+    // The server may still refuse to bind the pixmap, in which case the
+    // pixmaps of this depth are drawn without the extension from now on
+    Display *display = QX11Info::display();
+    XErrorTrap *xErrorTrap = XErrorTrap::instance();
+    unsigned long request = xErrorTrap->trapNextRequest();
+    d->glxPixmap = glXCreatePixmap(display, config.config, pixmap, attributes);
+    X11Wrapper::XSync(display, False);
+    if (xErrorTrap->takeError(request) != Success) {
+        if (d->glxPixmap != 0) {
+            xErrorTrap->ignore(xErrorTrap->trapNextRequest());
+            glXDestroyPixmap(display, d->glxPixmap);
+            d->glxPixmap = 0;
+        }
+        textureConfigs.insert(depth, TextureConfig());
+        qWarning("Binding pixmaps of depth %d to textures failed; drawing them without GLX_EXT_texture_from_pixmap", depth);
+    }
+    if (d->glxPixmap == 0) {
+        return;
+    }
+
+    deleteOrphanedTextures();
+    d->context = glXGetCurrentContext();
+    glGenTextures(1, &d->texture);
+    glBindTexture(GL_TEXTURE_2D, d->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+GLXTexturePixmap::~GLXTexturePixmap()
+{
+    // The texture can only be deleted in its own context; otherwise it is
+    // deleted the next time a texture is created or drawn in that context
+    if (d->texture != 0) {
+        if (glXGetCurrentContext() == d->context) {
+            glDeleteTextures(1, &d->texture);
+        } else {
+            orphanedTextures[d->context].append(d->texture);
+        }
+    }
+    if (d->glxPixmap != 0) {
+        glXDestroyPixmap(QX11Info::display(), d->glxPixmap);
+    }
+    delete d;
+}
+
+bool GLXTexturePixmap::isValid() const
+{
+    return d->glxPixmap != 0 && d->texture != 0;
+}
+
+Qt::HANDLE GLXTexturePixmap::pixmap() const
+{
+    return d->pixmap;
+}
+
+void GLXTexturePixmap::draw(const QRectF &target, qreal opacity)
+{
+    if (!isValid()) {
+        return;
+    }
+
+    deleteOrphanedTextures();
+
+    // Leave the state of the paint engine as it was
+    glPushAttrib(GL_CURRENT_BIT | GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_TEXTURE_BIT);
+
+    Display *display = QX11Info::display();
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, d->texture);
+
+    // Binding picks up the current contents of the pixmap
+    bindTexImage(display, d->glxPixmap, GLX_FRONT_LEFT_EXT, NULL);
+
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    if (d->hasAlpha || opacity < 1) {
+        // The pixmap contents are premultiplied so the color is too
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    } else {
+        glDisable(GL_BLEND);
+    }
+    glColor4f(opacity, opacity, opacity, opacity);
+
+    GLfloat top = d->yInverted ? 0 : 1;
+    GLfloat bottom = d->yInverted ? 1 : 0;
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, top);
+    glVertex2f(target.left(), target.top());
+    glTexCoord2f(1, top);
+    glVertex2f(target.right(), target.top());
+    glTexCoord2f(1, bottom);
+    glVertex2f(target.right(), target.bottom());
+    glTexCoord2f(0, bottom);
+    glVertex2f(target.left(), target.bottom());
+    glEnd();
+
+    releaseTexImage(display, d->glxPixmap, GLX_FRONT_LEFT_EXT);
+    glPopAttrib();
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef GLXTEXTUREPIXMAP_H
+#define GLXTEXTUREPIXMAP_H
+
+#include <QRectF>
+
+/*!
+ * A GL texture bound to an X pixmap through GLX_EXT_texture_from_pixmap.
+ * The contents of the pixmap are used by the GL implementation directly
+ * instead of being read back from the X server, which is what drawing an
+ * X pixmap with the OpenGL paint engine would otherwise do.
+ *
+ * The extension can be disabled by setting the LIPSTICK_NO_TEXTURE_FROM_PIXMAP
+ * environment variable, in which case isSupported() returns false.
+ */
+class GLXTexturePixmap
+{
+public:
+    /*!
+     * Returns whether GLX_EXT_texture_from_pixmap is available. A current GL
+     * context is required for resolving the extension functions.
+     */
+    static bool isSupported();
+
+    /*!
+     * Creates a texture for an X pixmap. If there is no GLX framebuffer
+     * configuration that can be bound to a texture for the depth of the
+     * pixmap, or the X server fails to create the GLX pixmap, the texture is
+     * not valid. After such a failure the pixmaps of that depth are no longer
+     * bound to textures.
+     *
+     * \param pixmap the X pixmap
+     * \param depth the depth of the X pixmap
+     */
+    GLXTexturePixmap(Qt::HANDLE pixmap, int depth);
+
+    /*!
+     * Destroys the texture. The X pixmap itself is not freed. If the GL
+     * context the texture was created in isn't current, the texture is
+     * deleted the next time a texture is created or drawn in that context.
+     */
+    ~GLXTexturePixmap();
+
+    //! Returns whether the texture can be drawn
+    bool isValid() const;
+
+    //! Returns the X pixmap of the texture
+    Qt::HANDLE pixmap() const;
+
+    /*!
+     * Draws the current contents of the pixmap with the current GL context.
+     * Call between QPainter::beginNativePainting() and
+     * QPainter::endNativePainting() so that the coordinates are those of
+     * the painter.
+     *
+     * \param target the rectangle to draw the pixmap to
+     * \param opacity the opacity to draw the pixmap with
+     */
+    void draw(const QRectF &target, qreal opacity);
+
+private:
+    struct Private;
+    Private * const d;
+};
+
+#endif // GLXTEXTUREPIXMAP_H
@@ -33,8 +33,10 @@
 #ifdef HAS_ADAPTER
 #include "homescreenadaptor.h"
 #endif
+#include "atomcache.h"
 #include "windowinfo.h"
 #include "xeventlistener.h"
+#include "xdamagelistener.h"
 #include "x11wrapper.h"
 
 /*!
@@ -50,6 +52,12 @@ static const QString HOME_READY_SIGNAL_PATH = "/com/nokia/duihome";
 static const QString HOME_READY_SIGNAL_INTERFACE = "com.nokia.duihome.readyNotifier";
 static const QString HOME_READY_SIGNAL_NAME = "ready";
 
+//! The interval in milliseconds for processing the damage, i.e. the length of a frame
+static const int XDAMAGE_PROCESSING_INTERVAL = 16;
+
+//! The interval in milliseconds for sampling the damage repaint rate
+static const int XDAMAGE_REPAINT_RATE_INTERVAL = 1000;
+
 HomeApplication::HomeApplication(int &argc, char **argv)
     : QApplication(argc, argv)
     , upstartMode(false)
@@ -58,11 +66,20 @@ HomeApplication::HomeApplication(int &argc, char **argv)
     , xEventListeners()
     , iteratorActiveForEventListenerContainer(false)
     , toBeRemovedEventListeners()
+    , xDamageRepaintCount(0)
+    , xDamageRepaintsPerSecond_(0)
     , xDamageEventBase(0)
     , xDamageErrorBase(0)
 {
     XDamageQueryExtension(QX11Info::display(), &xDamageEventBase, &xDamageErrorBase);
 
+    xDamageProcessingTimer.setSingleShot(true);
+    xDamageProcessingTimer.setInterval(XDAMAGE_PROCESSING_INTERVAL);
+    connect(&xDamageProcessingTimer, SIGNAL(timeout()), this, SLOT(processPendingXDamage()));
+    xDamageRepaintRateTimer.setSingleShot(true);
+    xDamageRepaintRateTimer.setInterval(XDAMAGE_REPAINT_RATE_INTERVAL);
+    connect(&xDamageRepaintRateTimer, SIGNAL(timeout()), this, SLOT(sampleXDamageRepaintRate()));
+
     parseArguments(argc, argv);
     // launch a timer for sending a dbus-signal upstart when basic construct is done
     connect(&startupNotificationTimer, SIGNAL(timeout()),
@@ -83,7 +100,7 @@ HomeApplication::HomeApplication(int &argc, char **argv)
     connect(homeScreenService, SIGNAL(focusToLauncherApp(const QString&)), this, SIGNAL(focusToLauncherAppRequested(const QString &)));
 
     // Initialize the X11 atoms used in the UI components
-    WindowInfo::initializeAtoms();
+    AtomCache::initialize(QX11Info::display());
 }
 
 HomeApplication::~HomeApplication()
@@ -107,6 +124,59 @@ void HomeApplication::removeXEventListener(XEventListener *listener)
     }
 }
 
+void HomeApplication::addXDamageListener(Qt::HANDLE damage, XDamageListener *listener)
+{
+    if (damage != 0 && listener != NULL) {
+        xDamageListeners.insert(damage, listener);
+    }
+}
+
+void HomeApplication::removeXDamageListener(Qt::HANDLE damage)
+{
+    xDamageListeners.remove(damage);
+    pendingXDamage.remove(damage);
+}
+
+int HomeApplication::xDamageRepaintsPerSecond() const
+{
+    return xDamageRepaintsPerSecond_;
+}
+
+void HomeApplication::processPendingXDamage()
+{
+    // Take the pending set first so that listeners may add or remove Damage objects
+    QSet<Qt::HANDLE> damages = pendingXDamage;
+    pendingXDamage.clear();
+
+    foreach (Qt::HANDLE damage, damages) {
+        if (XDamageListener *listener = xDamageListeners.value(damage)) {
+            listener->processXDamage();
+            xDamageRepaintCount++;
+        }
+    }
+
+    if (xDamageRepaintCount > 0 && !xDamageRepaintRateTimer.isActive()) {
+        xDamageRepaintRateTimer.start();
+    }
+}
+
+void HomeApplication::sampleXDamageRepaintRate()
+{
+    if (xDamageRepaintsPerSecond_ != xDamageRepaintCount) {
+        xDamageRepaintsPerSecond_ = xDamageRepaintCount;
+#ifdef BENCHMARKS_ON
+        qDebug() << "XDamage repaints per second:" << xDamageRepaintsPerSecond_;
+#endif
+        emit xDamageRepaintsPerSecondChanged();
+    }
+
+    // Keep sampling until a period without any repaints has been recorded
+    if (xDamageRepaintCount > 0) {
+        xDamageRepaintCount = 0;
+        xDamageRepaintRateTimer.start();
+    }
+}
+
 QVariant HomeApplication::lockedOrientation() const
 {
     return lockedOrientation_;
@@ -138,13 +208,19 @@ bool HomeApplication::x11EventFilter(XEvent *event)
     iteratorActiveForEventListenerContainer = true;
 
     if (event->type == xDamageEventBase + XDamageNotify) {
-        qDebug() << Q_FUNC_INFO << "Processing damage event";
-        XDamageNotifyEvent *xevent = (XDamageNotifyEvent *) event;
+        const XDamageNotifyEvent *xevent = (const XDamageNotifyEvent *) event;
 
-        // xevent->more would inform us if there is more events for the
-        // rendering operation. but there isn't interface to pass the
-        // information to damageEvent.
-        emit damageEvent(xevent->damage, xevent->area.x, xevent->area.y, xevent->area.width, xevent->area.height);
+        if (XDamageListener *listener = xDamageListeners.value(xevent->damage)) {
+            listener->handleXDamageNotify(*xevent);
+            pendingXDamage.insert(xevent->damage);
+        }
+
+        // xevent->more tells that more events follow for the same rendering
+        // operation; the damage is processed once they have all arrived and
+        // at most once per frame.
+        if (!xevent->more && !pendingXDamage.isEmpty() && !xDamageProcessingTimer.isActive()) {
+            xDamageProcessingTimer.start();
+        }
         eventHandled = true;
     }
 
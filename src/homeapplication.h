@@ -23,10 +23,12 @@
 #include <QApplication>
 #include <QTimer>
 #include <QSet>
+#include <QHash>
 #include <QVariant>
 
 class HomeScreenService;
 class XEventListener;
+class XDamageListener;
 
 /*!
  * HomeApplication extends MApplication with additional services.
@@ -34,6 +36,7 @@ class XEventListener;
 class HomeApplication : public QApplication
 {
     Q_OBJECT
+    Q_PROPERTY(int xDamageRepaintsPerSecond READ xDamageRepaintsPerSecond NOTIFY xDamageRepaintsPerSecondChanged)
 
 public:
     /*!
@@ -66,6 +69,28 @@ public:
      */
     void removeXEventListener(XEventListener *listener);
 
+    /*!
+     * Adds a listener for the XDamageNotify events of \a damage. The events
+     * of each Damage object are delivered only to its own listener.
+     * Before destroying the Damage object, remove the listener by calling
+     * \c removeXDamageListener.
+     * \param damage the Damage object to listen to
+     * \param listener the listener
+     */
+    void addXDamageListener(Qt::HANDLE damage, XDamageListener *listener);
+
+    /*!
+     * Removes the listener of \a damage.
+     * \param damage the Damage object to stop listening to
+     */
+    void removeXDamageListener(Qt::HANDLE damage);
+
+    /*!
+     * Returns the number of XDamage listeners processed during the last
+     * second, i.e. the number of repaints caused by damaged windows.
+     */
+    int xDamageRepaintsPerSecond() const;
+
     /*!
      * Returns the locked orientation as set using the command line
      * arguments. The orientation is returned as a QVariant. If the
@@ -85,16 +110,14 @@ signals:
      */
      void focusToLauncherAppRequested(const QString &fileEntryPath);
 
+    //! Emitted when the number of repaints caused by damaged windows per second changes
+    void xDamageRepaintsPerSecondChanged();
+
 #ifdef BENCHMARKS_ON
     void startBenchmarking();
     void stopBenchmarking();
 #endif
 
-    /*!
-     * Signal application about a changed X pixmap
-     */
-    void damageEvent(Qt::HANDLE &damage, short &x, short &y, unsigned short &width, unsigned short &height);
-
 protected:
     //! \reimp
     virtual bool x11EventFilter(XEvent *event);
@@ -107,6 +130,12 @@ private slots:
      */
     void sendStartupNotifications();
 
+    //! Lets each listener with pending damage process it once for this frame
+    void processPendingXDamage();
+
+    //! Updates the number of repaints caused by damaged windows per second
+    void sampleXDamageRepaintRate();
+
 private:
     /*!
      * Parses the command line parameters and sets upstart mode and forced
@@ -141,6 +170,24 @@ private:
     //! Once a listener is on this list, it won't receive any X events any more.
     QList<XEventListener*> toBeRemovedEventListeners;
 
+    //! The XDamageNotify listeners by their Damage handles
+    QHash<Qt::HANDLE, XDamageListener*> xDamageListeners;
+
+    //! The Damage handles that have received events since they were last processed
+    QSet<Qt::HANDLE> pendingXDamage;
+
+    //! Timer for processing the pending damage once per frame
+    QTimer xDamageProcessingTimer;
+
+    //! Timer for sampling the number of repaints caused by damage
+    QTimer xDamageRepaintRateTimer;
+
+    //! The number of repaints caused by damage during the current sampling period
+    int xDamageRepaintCount;
+
+    //! The number of repaints caused by damage during the last second
+    int xDamageRepaintsPerSecond_;
+
     int xDamageEventBase;
     int xDamageErrorBase;
 #ifdef UNIT_TEST
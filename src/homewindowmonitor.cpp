@@ -22,6 +22,7 @@
 
 #include "homewindowmonitor.h"
 #include "x11wrapper.h"
+#include "atomcache.h"
 
 
 QSharedPointer<HomeWindowMonitor> HomeWindowMonitor::windowMonitorInstance = QSharedPointer<HomeWindowMonitor>();
@@ -36,10 +37,8 @@ const HomeWindowMonitor *HomeWindowMonitor::instance()
 }
 
 HomeWindowMonitor::HomeWindowMonitor() :
-        nonFullscreenApplicationWindowTypes(QSet<Atom>() << WindowInfo::NotificationAtom <<
-                                                            WindowInfo::DialogAtom <<
-                                                            WindowInfo::MenuAtom),
-        netClientListStacking(X11Wrapper::XInternAtom(QX11Info::display(), "_NET_CLIENT_LIST_STACKING", False))
+        stackingOrderValid(false),
+        homeWindowOnTop(false)
 {
 }
 
@@ -47,32 +46,37 @@ HomeWindowMonitor::~HomeWindowMonitor()
 {
 }
 
+bool HomeWindowMonitor::isOwnTopLevelWidget(WId wid)
+{
+    QWidget *widget = QWidget::find(wid);
+    return widget != NULL && widget->isWindow();
+}
+
 bool HomeWindowMonitor::isOwnWindow(WId wid) const
 {
-    foreach (QWidget *window, QApplication::topLevelWidgets()) {
-        if (window->winId() == wid) {
-            return true;
-        }
+    if (stackingOrderValid && stackingWindows.contains(wid)) {
+        return ownWindows.contains(wid);
     }
 
-    return false;
+    return isOwnTopLevelWidget(wid);
 }
 
 bool HomeWindowMonitor::handleXEvent(const XEvent& event)
 {
     bool eventHandled = false;
 
-    if (event.type == PropertyNotify && event.xproperty.atom == netClientListStacking && event.xproperty.window == DefaultRootWindow(QX11Info::display())) {
-        int numWindowStackingOrderReceivers = receivers(SIGNAL(windowStackingOrderChanged(QList<WindowInfo>)));
+    if (event.type == PropertyNotify && event.xproperty.atom == AtomCache::atom(AtomCache::NetClientListStacking) && event.xproperty.window == DefaultRootWindow(QX11Info::display())) {
+        int numWindowStackingOrderReceivers = receivers(SIGNAL(windowStackingOrderChanged(QList<WindowInfo *>)));
         int numFullscreenWindowReceivers = receivers(SIGNAL(fullscreenWindowOnTopOfOwnWindow()));
-        int numAnyWindowReceivers = receivers(SIGNAL(anyWindowOnTopOfOwnWindow(WindowInfo)));
-
-        if (numWindowStackingOrderReceivers + numFullscreenWindowReceivers + numAnyWindowReceivers > 0) {
-            QList<Window> windowOrder = windowStackingOrder();
+        int numAnyWindowReceivers = receivers(SIGNAL(anyWindowOnTopOfOwnWindow(WindowInfo *)));
 
+        if (numWindowStackingOrderReceivers + numFullscreenWindowReceivers + numAnyWindowReceivers == 0) {
+            // Nobody needs to know right now; fetch the order when it is asked for
+            stackingOrderValid = false;
+        } else if (updateStackingOrder() != StackingOrderUnchanged) {
             if (numWindowStackingOrderReceivers > 0) {
                 QList<WindowInfo *> windowStackingList;
-                foreach (Window wid, windowOrder) {
+                foreach (Window wid, cachedStackingOrder) {
                     windowStackingList.append(WindowInfo::windowFor(wid));
                 }
 
@@ -80,29 +84,25 @@ bool HomeWindowMonitor::handleXEvent(const XEvent& event)
             }
 
             if (numFullscreenWindowReceivers + numAnyWindowReceivers > 0) {
-                if (!windowOrder.isEmpty()) {
-                    QListIterator<Window> iter(windowOrder);
-                    iter.toBack();
-                    bool anyWindowSignalEmitted = false;
-                    while (iter.hasPrevious()) {
-                        WindowInfo *windowInfo = WindowInfo::windowFor(iter.previous());
-                        if (isOwnWindow(windowInfo->window())) {
-                            break;
-                        }
-                        if (numAnyWindowReceivers > 0 && !anyWindowSignalEmitted) {
-                            emit anyWindowOnTopOfOwnWindow(windowInfo);
-                            // signal is sent only once per each XEvent, mark signal sent
-                            anyWindowSignalEmitted = true;
-                            if (numFullscreenWindowReceivers < 1) {
-                                // no listeners for fullscreenWindowOnTopOfOwnWindow() signal
-                                break;
-                            }
-                        }
-                        if (windowInfo->types().toSet().intersect(nonFullscreenApplicationWindowTypes).isEmpty()) {
-                            emit fullscreenWindowOnTopOfOwnWindow();
+                bool anyWindowSignalEmitted = false;
+                for (int i = cachedStackingOrder.count() - 1; i >= 0; --i) {
+                    if (ownWindows.contains(cachedStackingOrder.at(i))) {
+                        break;
+                    }
+                    WindowInfo *windowInfo = WindowInfo::windowFor(cachedStackingOrder.at(i));
+                    if (numAnyWindowReceivers > 0 && !anyWindowSignalEmitted) {
+                        emit anyWindowOnTopOfOwnWindow(windowInfo);
+                        // signal is sent only once per each XEvent, mark signal sent
+                        anyWindowSignalEmitted = true;
+                        if (numFullscreenWindowReceivers < 1) {
+                            // no listeners for fullscreenWindowOnTopOfOwnWindow() signal
                             break;
                         }
                     }
+                    if (windowInfo->isFullscreenApplicationWindow()) {
+                        emit fullscreenWindowOnTopOfOwnWindow();
+                        break;
+                    }
                 }
             }
         }
@@ -112,45 +112,92 @@ bool HomeWindowMonitor::handleXEvent(const XEvent& event)
     return eventHandled;
 }
 
-QList<Window> HomeWindowMonitor::windowStackingOrder() const
+QVector<Window> HomeWindowMonitor::windowStackingOrder() const
 {
     Display *display = QX11Info::display();
     Atom actualType;
     int actualFormat;
     unsigned long numWindowItems, bytesLeft;
     unsigned char *windowData = NULL;
-    Status result = X11Wrapper::XGetWindowProperty(display, DefaultRootWindow(display), netClientListStacking,
+    Status result = X11Wrapper::XGetWindowProperty(display, DefaultRootWindow(display), AtomCache::atom(AtomCache::NetClientListStacking),
                                                    0, 0x7fffffff, False, XA_WINDOW,
                                                    &actualType, &actualFormat, &numWindowItems, &bytesLeft, &windowData);
 
-    QList<Window> stackingWindowList;
+    QVector<Window> stackingWindowList;
 
     if (result == Success && windowData != None) {
         Window *windows = (Window *)windowData;
+        stackingWindowList.reserve(numWindowItems);
         for (unsigned int i = 0; i < numWindowItems; i++) {
             stackingWindowList.append(windows[i]);
         }
+        X11Wrapper::XFree(windowData);
     }
 
     return stackingWindowList;
 }
 
+HomeWindowMonitor::StackingOrderChange HomeWindowMonitor::updateStackingOrder() const
+{
+    QVector<Window> newStackingOrder = windowStackingOrder();
+    if (stackingOrderValid && newStackingOrder == cachedStackingOrder) {
+        return StackingOrderUnchanged;
+    }
+
+    StackingOrderChange change = StackingOrderReordered;
+    QSet<Window> newStackingWindows;
+    newStackingWindows.reserve(newStackingOrder.count());
+    foreach (Window wid, newStackingOrder) {
+        newStackingWindows.insert(wid);
+    }
+
+    if (!stackingOrderValid || newStackingWindows != stackingWindows) {
+        // Windows were added or removed; only the changed ones need to be classified
+        change = StackingOrderWindowsChanged;
+        foreach (Window wid, stackingWindows) {
+            if (!newStackingWindows.contains(wid)) {
+                ownWindows.remove(wid);
+            }
+        }
+        foreach (Window wid, newStackingWindows) {
+            if ((!stackingOrderValid || !stackingWindows.contains(wid)) && isOwnTopLevelWidget(wid)) {
+                ownWindows.insert(wid);
+            }
+        }
+        stackingWindows = newStackingWindows;
+    }
+
+    cachedStackingOrder = newStackingOrder;
+    homeWindowOnTop = !cachedStackingOrder.isEmpty() && ownWindows.contains(cachedStackingOrder.last());
+    stackingOrderValid = true;
+
+    return change;
+}
+
+const QVector<Window> &HomeWindowMonitor::stackingOrder() const
+{
+    if (!stackingOrderValid) {
+        updateStackingOrder();
+    }
+
+    return cachedStackingOrder;
+}
+
 bool HomeWindowMonitor::isHomeWindowOnTop() const
 {
-    QList<Window> windowOrder = windowStackingOrder();
-    return isOwnWindow(windowOrder.last());
+    stackingOrder();
+    return homeWindowOnTop;
 }
 
-bool HomeWindowMonitor::isHomeWindowOnTop(QSet<Atom> ignoredWindows) const
+bool HomeWindowMonitor::isHomeWindowOnTop(WindowInfo::WindowFlags ignoredTypes) const
 {
-    QList<Window> windowOrder = windowStackingOrder();
-    for (int i = windowOrder.length() - 1; i >= 0; --i)
+    const QVector<Window> &windowOrder = stackingOrder();
+    for (int i = windowOrder.count() - 1; i >= 0; --i)
     {
-        if (isOwnWindow(windowOrder[i])) {
+        if (ownWindows.contains(windowOrder.at(i))) {
             return true;
         }
-        QSet<Atom> windowTypes = WindowInfo::windowFor(windowOrder[i])->types().toSet();
-        if (windowTypes.intersect(ignoredWindows).isEmpty()) {
+        if (!(WindowInfo::windowFor(windowOrder.at(i))->flags() & ignoredTypes)) {
              break;
         }
     }
@@ -22,6 +22,7 @@
 
 #include <QObject>
 #include <QSet>
+#include <QVector>
 #include "windowmonitor.h"
 #include "xeventlistener.h"
 
@@ -47,11 +48,11 @@ public:
     virtual bool handleXEvent(const XEvent& event);
     //! \reimp_end
 
-    //! Returns whether Home is the topmost window
+    //! Returns whether Home is the topmost window. The answer is cached between stacking order changes.
     bool isHomeWindowOnTop() const;
 
-    //! Returns true if Home is highest window excluding windows defined by ignoredWindows
-    bool isHomeWindowOnTop(QSet<Atom> ignoredWindows) const;
+    //! Returns true if Home is highest window excluding windows having any of the types in ignoredTypes
+    bool isHomeWindowOnTop(WindowInfo::WindowFlags ignoredTypes) const;
 
 protected:
     /*!
@@ -60,22 +61,50 @@ protected:
     HomeWindowMonitor();
 
 private:
+    //! The kinds of changes to the stacking order
+    enum StackingOrderChange {
+        StackingOrderUnchanged,
+        StackingOrderReordered,
+        StackingOrderWindowsChanged
+    };
 
     // HomeWindowMonitor singleton instance.
     static QSharedPointer<HomeWindowMonitor> windowMonitorInstance;
 
-    //! The window types for windows that are not considered to be full screen
-    //! application windows
-    const QSet<Atom> nonFullscreenApplicationWindowTypes;
-
-    //! An X atom for _NET_CLIENT_LIST_STACKING
-    const Atom netClientListStacking;
-
     /*!
      * Queries the current window stacking order from X and returns the windows
      * in that order. The topmost window is the last one in the list.
      */
-    QList<Window> windowStackingOrder() const;
+    QVector<Window> windowStackingOrder() const;
+
+    /*!
+     * Fetches the stacking order from X and updates the cached stacking order
+     * and the set of own windows from it.
+     *
+     * \return how the stacking order changed compared to the cached one
+     */
+    StackingOrderChange updateStackingOrder() const;
+
+    //! Returns the cached stacking order, fetching it first if it is not valid
+    const QVector<Window> &stackingOrder() const;
+
+    //! Returns whether \a wid is one of the top level widgets of this application
+    static bool isOwnTopLevelWidget(WId wid);
+
+    //! The cached window stacking order. The topmost window is the last one.
+    mutable QVector<Window> cachedStackingOrder;
+
+    //! The windows in the cached stacking order
+    mutable QSet<Window> stackingWindows;
+
+    //! The windows in the cached stacking order that belong to this application
+    mutable QSet<Window> ownWindows;
+
+    //! Whether the cached stacking order reflects the current one
+    mutable bool stackingOrderValid;
+
+    //! Whether the topmost window in the cached stacking order is an own window
+    mutable bool homeWindowOnTop;
 
 #ifdef UNIT_TEST
     friend class Ut_HomeWindowMonitor;
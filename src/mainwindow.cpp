@@ -25,6 +25,7 @@
 #include <QGLWidget>
 
 #include "x11wrapper.h"
+#include "atomcache.h"
 
 MainWindow *MainWindow::mainWindowInstance = NULL;
 const QString MainWindow::CONTENT_SEARCH_DBUS_SERVICE = "com.nokia.maemo.meegotouch.ContentSearch";
@@ -93,12 +94,12 @@ MainWindow *MainWindow::instance(bool create)
 void MainWindow::excludeFromTaskBar()
 {
     // Tell the window to not to be shown in the switcher
-    Atom skipTaskbarAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_STATE_SKIP_TASKBAR", False);
+    Atom skipTaskbarAtom = AtomCache::atom(AtomCache::NetWmStateSkipTaskbar);
     changeNetWmState(true, skipTaskbarAtom);
 
     // Also set the _NET_WM_STATE window property to ensure Home doesn't try to
     // manage this window in case the window manager fails to set the property in time
-    Atom netWmStateAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_STATE", False);
+    Atom netWmStateAtom = AtomCache::atom(AtomCache::NetWmState);
     QVector<Atom> atoms;
     atoms.append(skipTaskbarAtom);
     X11Wrapper::XChangeProperty(QX11Info::display(), internalWinId(), netWmStateAtom, XA_ATOM, 32, PropModeReplace, (unsigned char *)atoms.data(), atoms.count());
@@ -109,8 +110,7 @@ void MainWindow::changeNetWmState(bool set, Atom one, Atom two)
     XEvent e;
     e.xclient.type = ClientMessage;
     Display *display = QX11Info::display();
-    Atom netWmStateAtom = X11Wrapper::XInternAtom(display, "_NET_WM_STATE", FALSE);
-    e.xclient.message_type = netWmStateAtom;
+    e.xclient.message_type = AtomCache::atom(AtomCache::NetWmState);
     e.xclient.display = display;
     e.xclient.window = internalWinId();
     e.xclient.format = 32;
@@ -8,22 +8,59 @@
 
 #include <QtDeclarative/qdeclarative.h>
 #include <QDir>
-#include <QFileInfoList>
+#include <QFile>
+#include <QFileInfo>
 #include <QFileSystemWatcher>
 #include <QRegExp>
+#include <QtConcurrentMap>
+#include <QSet>
 #include <mdesktopentry.h>
+#include <dirent.h>
+#include <sys/stat.h>
 #include "menumodel.h"
 #include "desktop.h"
+#include "desktopcache.h"
+
+class MenuModel::DesktopParser
+{
+public:
+    typedef MenuModel::ParsedDesktop result_type;
+
+    DesktopParser(const QString &type) :
+        m_type(type)
+    {
+    }
+
+    ParsedDesktop operator()(const QString &fileName) const
+    {
+        ParsedDesktop parsed;
+        parsed.fileName = fileName;
+        parsed.data = Desktop::load(fileName);
+        parsed.accepted = parsed.data.valid &&
+                          parsed.data.type == m_type &&
+                          !parsed.data.noDisplay;
+        return parsed;
+    }
+
+private:
+    QString m_type;
+};
 
 MenuModel::MenuModel(QObject *parent) :
     QAbstractItemModel(parent),
-    m_type("Application")
+    m_type("Application"),
+    m_nextParsedApp(0)
 {
     m_watcher = new QFileSystemWatcher(this);
     connect(m_watcher, SIGNAL(directoryChanged(QString)), this, SLOT(appsDirChanged(QString)));
 
+    m_parser = new QFutureWatcher<ParsedDesktop>(this);
+    connect(m_parser, SIGNAL(resultsReadyAt(int, int)), this, SLOT(addParsedApps()));
+    connect(m_parser, SIGNAL(finished()), this, SLOT(finishParsingApps()));
+
     // Default dirs
-    m_watcher->addPath("/usr/share/applications");
+    m_directories << "/usr/share/applications";
+    m_watcher->addPaths(m_directories);
 
     QHash<int, QByteArray> roles;
     roles[id]="id";
@@ -37,96 +74,200 @@ MenuModel::MenuModel(QObject *parent) :
 
     setRoleNames(roles);
 
-    appsDirChanged("/usr/share/applications");
+    resetApps();
 }
 
 void MenuModel::appsDirChanged(QString changedDir)
 {
+    DirectorySnapshot oldSnapshot = m_snapshots.value(changedDir);
+    DirectorySnapshot snapshot = scanDirectory(changedDir);
+    m_snapshots.insert(changedDir, snapshot);
+
     QList<Desktop *> added;
     QList<Desktop *> removed;
-    QDir dir (changedDir);
-    dir.setFilter(QDir::Files | QDir::NoSymLinks);
+    int replaced = 0;
+    QDir dir(changedDir);
 
-    foreach (QFileInfo info, dir.entryInfoList())
+    // Files that are new or whose stamp differs have been added or modified
+    for (DirectorySnapshot::const_iterator file = snapshot.constBegin(); file != snapshot.constEnd(); ++file)
     {
-        bool found = false;
-        foreach (Desktop *d, m_apps)
-        {
-            if (info.absoluteFilePath().endsWith(d->filename().right(d->filename().lastIndexOf('/'))))
-            {
-                found = true;
-                break;
-            }
-        }
-        if (!found)
-        {
-            qDebug() << "Created desktop file " << info.absoluteFilePath();
-            Desktop *desktopEntry = new Desktop(info.absoluteFilePath());
-            if (!desktopEntry->isValid() || (desktopEntry->type() != m_type))
-            {
-                delete desktopEntry;
-            }
-            else
-            {
-                added << desktopEntry;
-            }
-        }
+        DirectorySnapshot::const_iterator oldFile = oldSnapshot.constFind(file.key());
+        if (oldFile != oldSnapshot.constEnd() && *oldFile == *file)
+            continue;
+
+        resolveApp(file.key(), changedDir, &added, &removed, &replaced);
     }
 
-    foreach (Desktop *d, m_apps)
+    // Files that are no longer there have been removed
+    for (DirectorySnapshot::const_iterator oldFile = oldSnapshot.constBegin(); oldFile != oldSnapshot.constEnd(); ++oldFile)
     {
-        if (!d->filename().contains(changedDir))
+        if (snapshot.contains(oldFile.key()))
             continue;
 
-        bool found = false;
-        foreach (QFileInfo info, dir.entryInfoList())
-        {
-            if (d->filename() == info.absoluteFilePath())
-            {
-                found = true;
-                break;
-            }
-        }
-        if (!found)
-        {
-            removed << d;
-        }
+        DesktopCache::instance()->remove(dir.absoluteFilePath(oldFile.key()));
+        resolveApp(oldFile.key(), changedDir, &added, &removed, &replaced);
+    }
+
+    // Only the affected rows change so the rest of the delegates are kept
+    removeApps(removed);
+    insertApps(added);
+
+    if (removed.length() > 0 || added.length() > 0 || replaced > 0)
+        emit appsChanged();
+}
+
+MenuModel::DirectorySnapshot MenuModel::scanDirectory(const QString &path)
+{
+    DirectorySnapshot snapshot;
+    QByteArray encodedPath = QFile::encodeName(path);
+    DIR *dir = opendir(encodedPath.constData());
+    if (!dir)
+        return snapshot;
+
+    while (struct dirent *entry = readdir(dir))
+    {
+        QString fileName = QFile::decodeName(entry->d_name);
+        if (!fileName.endsWith(".desktop"))
+            continue;
+
+        struct stat info;
+        if (lstat((encodedPath + '/' + entry->d_name).constData(), &info) != 0 || !S_ISREG(info.st_mode))
+            continue;
+
+        FileStamp stamp;
+        stamp.inode = info.st_ino;
+        stamp.mtime = qint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        stamp.size = info.st_size;
+        snapshot.insert(fileName, stamp);
     }
+    closedir(dir);
+
+    return snapshot;
+}
 
-    if (removed.length() > 0)
+QString MenuModel::providingDirectory(const QString &fileName) const
+{
+    // The first directory with a file of the name provides the entry
+    foreach (QString target, m_directories)
     {
-        QList<Desktop *> tmp;
-        while (!m_apps.isEmpty())
-        {
-            Desktop *d = m_apps.takeLast();
-            if (removed.contains(d))
-            {
-                delete d;
-            }
-            else
-            {
-                tmp << d;
-            }
-        }
+        if (m_snapshots.value(target).contains(fileName))
+            return target;
+    }
+    return QString();
+}
+
+Desktop *MenuModel::shownApp(const QString &fileName) const
+{
+    foreach (QString target, m_directories)
+    {
+        Desktop *desktop = m_appsByPath.value(QDir(target).absoluteFilePath(fileName));
+        if (desktop)
+            return desktop;
+    }
+    return 0;
+}
+
+void MenuModel::resolveApp(const QString &fileName, const QString &changedDir,
+                           QList<Desktop *> *added, QList<Desktop *> *removed, int *replaced)
+{
+    Desktop *oldDesktop = shownApp(fileName);
+    QString directory = providingDirectory(fileName);
+    QString path = directory.isEmpty() ? QString() : QDir(directory).absoluteFilePath(fileName);
+
+    // A change shadowed by an earlier directory leaves the shown entry as it is
+    if (oldDesktop && oldDesktop->filename() == path && directory != changedDir)
+        return;
+
+    Desktop *desktopEntry = path.isEmpty() ? 0 : createDesktop(path);
+    if (oldDesktop && desktopEntry)
+    {
+        replaceApp(oldDesktop, desktopEntry);
+        (*replaced)++;
+    }
+    else if (oldDesktop)
+        *removed << oldDesktop;
+    else if (desktopEntry)
+        *added << desktopEntry;
+}
+
+void MenuModel::replaceApp(Desktop *oldDesktop, Desktop *newDesktop)
+{
+    int row = m_apps.indexOf(oldDesktop);
+    m_apps[row] = newDesktop;
+    m_appsByPath.remove(oldDesktop->filename());
+    m_appsByPath.insert(newDesktop->filename(), newDesktop);
+    m_appsById.remove(oldDesktop->id());
+    m_appsById.insert(newDesktop->id(), newDesktop);
+    emit dataChanged(index(row, 0), index(row, 0));
+    delete oldDesktop;
+}
+
+Desktop *MenuModel::createDesktop(const QString &fileName)
+{
+    ParsedDesktop parsed = DesktopParser(m_type)(fileName);
+    if (!parsed.accepted)
+        return 0;
+
+    return new Desktop(parsed.fileName, parsed.data);
+}
+
+void MenuModel::insertApps(const QList<Desktop *> &desktops)
+{
+    if (desktops.isEmpty())
+        return;
+
+    beginInsertRows(QModelIndex(), m_apps.count(), m_apps.count() + desktops.count() - 1);
+    foreach (Desktop *d, desktops)
+    {
+        m_apps << d;
+        m_appsByPath.insert(d->filename(), d);
+        m_appsById.insert(d->id(), d);
+    }
+    endInsertRows();
+}
 
-        m_apps = tmp;
+void MenuModel::removeApps(const QList<Desktop *> &desktops)
+{
+    QList<int> rows;
+    foreach (Desktop *d, desktops)
+    {
+        int row = m_apps.indexOf(d);
+        if (row >= 0)
+            rows << row;
     }
+    qSort(rows);
 
-    if (added.length() > 0)
+    // Remove runs of contiguous rows at once, starting from the end so that the other rows stay put
+    int i = rows.count() - 1;
+    while (i >= 0)
     {
-        foreach (Desktop *d, added)
+        int last = rows.at(i);
+        int first = last;
+        while (i > 0 && rows.at(i - 1) == first - 1)
         {
-            m_apps << d;
+            first--;
+            i--;
         }
-    }
+        i--;
 
-    resetApps();
-    emit appsChanged();
+        QList<Desktop *> removed;
+        beginRemoveRows(QModelIndex(), first, last);
+        for (int row = last; row >= first; row--)
+        {
+            removed << m_apps.takeAt(row);
+            m_appsByPath.remove(removed.last()->filename());
+            m_appsById.remove(removed.last()->id());
+        }
+        endRemoveRows();
+
+        qDeleteAll(removed);
+    }
 }
 
 void MenuModel::setDirectories(QStringList directories)
 {
     m_watcher->removePaths(m_watcher->directories());
+    m_directories.clear();
 
     foreach(QString directory, directories)
     {
@@ -144,7 +285,12 @@ void MenuModel::setDirectories(QStringList directories)
             QDir().mkpath(path);
         }
 
-        m_watcher->addPath(path);
+        // The order is the precedence; a directory listed twice counts where it's first listed
+        if (!m_directories.contains(path))
+        {
+            m_directories << path;
+            m_watcher->addPath(path);
+        }
     }
 
     resetApps();
@@ -152,48 +298,83 @@ void MenuModel::setDirectories(QStringList directories)
 
 void MenuModel::resetApps()
 {
+    // Entries still being parsed for the previous directories are not needed
+    m_parser->cancel();
+    m_parser->waitForFinished();
+
     beginResetModel();
 
     while (!m_apps.isEmpty())
         delete m_apps.takeFirst();
 
+    m_appsByPath.clear();
+    m_appsById.clear();
+    m_snapshots.clear();
     m_categories.clear();
     m_appsHash.clear();
 
-    QStringList addedDirectories;
+    endResetModel();
+
+    QSet<QString> addedFileNames;
+    QStringList fileNames;
+    m_parsedDirectories.clear();
 
-    foreach (QString target, m_watcher->directories())
+    foreach (QString target, m_directories)
     {
-        QDir dir(target);
-        dir.setFilter(QDir::Files | QDir::NoSymLinks);
+        DirectorySnapshot snapshot = scanDirectory(target);
+        m_snapshots.insert(target, snapshot);
 
-        QStringList filters;
-        filters << "*.desktop";
-        foreach (QFileInfo fileInfo, dir.entryInfoList(filters))
+        QDir dir(target);
+        QStringList targetFileNames = snapshot.keys();
+        targetFileNames.sort();
+        foreach (QString fileName, targetFileNames)
         {
-
-            if(!fileInfo.fileName().endsWith(".desktop"))
+            if(addedFileNames.contains(fileName))
                 continue;
 
-            if(addedDirectories.contains(fileInfo.fileName()))
-                continue;
+            addedFileNames << fileName;
+            fileNames << dir.absoluteFilePath(fileName);
+            m_parsedDirectories << target;
+        }
+    }
 
-            addedDirectories<<fileInfo.fileName();
+    // The files are parsed by a thread pool and added to the model in
+    // batches as they get ready, so the launcher fills in progressively
+    m_nextParsedApp = 0;
+    m_parser->setFuture(QtConcurrent::mapped(fileNames, DesktopParser(m_type)));
+}
 
-            Desktop *desktopEntry = new Desktop(fileInfo.absoluteFilePath());
-            if (!desktopEntry->isValid() ||
-                desktopEntry->type() != m_type ||
-                desktopEntry->nodisplay())
-            {
-                delete desktopEntry;
-                continue;
-            }
+void MenuModel::addParsedApps()
+{
+    QFuture<ParsedDesktop> future = m_parser->future();
+    QList<Desktop *> desktops;
 
-            m_apps << desktopEntry;
-        }
+    // The results may get ready out of order; only the ones up to the first missing one are added
+    while (future.isResultReadyAt(m_nextParsedApp))
+    {
+        const QString &directory = m_parsedDirectories.at(m_nextParsedApp);
+        ParsedDesktop parsed = future.resultAt(m_nextParsedApp++);
+        if (!parsed.accepted)
+            continue;
+
+        // A file changed during the parsing may have been resolved by appsDirChanged() already,
+        // and one removed or shadowed during the parsing no longer provides the entry
+        QString fileName = QFileInfo(parsed.fileName).fileName();
+        if (shownApp(fileName) || providingDirectory(fileName) != directory)
+            continue;
+
+        desktops << new Desktop(parsed.fileName, parsed.data);
     }
 
-    endResetModel();
+    insertApps(desktops);
+}
+
+void MenuModel::finishParsingApps()
+{
+    if (m_parser->isCanceled())
+        return;
+
+    addParsedApps();
     emit appsReset();
 }
 
@@ -231,6 +412,8 @@ QVariant MenuModel::data(const QModelIndex& index, int role) const
     Desktop *i = m_apps.at(index.row());
 
     switch (role) {
+        case id:
+            return i->id();
         case name:
             return i->title();
         case exec:
@@ -265,14 +448,21 @@ QDeclarativeListProperty<Desktop> MenuModel::apps()
 
 QString MenuModel::value(QString id, QString key)
 {
-	foreach(Desktop* item, m_apps)
-	{
-		if(item->id() == id)
-			return item->value(key);
-	}
+	Desktop *item = m_appsById.value(id);
+	if(item)
+		return item->value(key);
 	return "";
 }
 
+QVariant MenuModel::getObjectById(QString id)
+{
+    Desktop *item = m_appsById.value(id);
+    if (!item)
+        return QVariant();
+
+    return QVariant::fromValue<QObject *>(item);
+}
+
 QVariant MenuModel::getNameByIndex(int idx)
 {
     return data(index(idx, 0, QModelIndex()), name);
@@ -300,6 +490,8 @@ QVariant MenuModel::getFileNameByIndex(int idx)
 
 MenuModel::~MenuModel()
 {
+    m_parser->cancel();
+    m_parser->waitForFinished();
     qDeleteAll(m_apps);
 }
 
@@ -13,6 +13,7 @@
 #include <QtDeclarative>
 #include <QAbstractItemModel>
 #include <QHash>
+#include <QFutureWatcher>
 #include <mdesktopentry.h>
 #include "menuitem.h"
 #include "desktop.h"
@@ -48,11 +49,11 @@ public:
 
     QString directory() const {
         qDebug("Warning, 'directory' has been deprecated. Use 'directories' instead.");
-        return m_watcher->directories().at(0);
+        return m_directories.at(0);
     }
 
     QStringList directories() const {
-        return m_watcher->directories();
+        return m_directories;
     }
 
     void setDirectory(QString dir){ qDebug("Warning, directory property is deprecated. Use 'directories' instead"); setDirectories(QStringList()<<dir); }
@@ -85,19 +86,109 @@ public slots:
     QVariant getCommentByIndex(int idx);
     QVariant getIconByIndex(int idx);
     QVariant getFileNameByIndex(int idx);
+    QVariant getObjectById(QString id);
 
 private slots:
     void appsDirChanged(QString);
     void resetApps();
 
+    //! Adds the desktop entries parsed so far, in the order of the files
+    void addParsedApps();
+
+    //! Adds the rest of the parsed desktop entries once all have been parsed
+    void finishParsingApps();
+
 private:
+    //! A desktop file parsed in a worker thread
+    struct ParsedDesktop
+    {
+        ParsedDesktop()
+            : accepted(false)
+        {}
+
+        QString fileName;
+        DesktopCache::Entry data;
+
+        //! Whether the entry is valid, of the model's type and displayed
+        bool accepted;
+    };
+
+    //! Parses desktop files and checks whether they are shown; used from the worker threads
+    class DesktopParser;
+
+    //! The identity of a file as last seen in a directory listing
+    struct FileStamp
+    {
+        quint64 inode;
+        qint64 mtime;
+        qint64 size;
+
+        bool operator==(const FileStamp &other) const {
+            return inode == other.inode && mtime == other.mtime && size == other.size;
+        }
+    };
+
+    //! The desktop files of a directory by their file names
+    typedef QHash<QString, FileStamp> DirectorySnapshot;
+
+    //! Lists the desktop files of a directory
+    static DirectorySnapshot scanDirectory(const QString &path);
+
+    //! Returns the first directory that has a file of the name, which provides the entry, or an empty string
+    QString providingDirectory(const QString &fileName) const;
+
+    //! Returns the shown entry of a file name from any of the directories, or 0 if there is none
+    Desktop *shownApp(const QString &fileName) const;
+
+    /*!
+     * Finds the entry that should be shown for a file name after the file
+     * has been added, modified or removed in \a changedDir and updates the
+     * model if it differs from the shown one.
+     */
+    void resolveApp(const QString &fileName, const QString &changedDir,
+                    QList<Desktop *> *added, QList<Desktop *> *removed, int *replaced);
+
+    //! Replaces \a oldDesktop with \a newDesktop on the same row and deletes it
+    void replaceApp(Desktop *oldDesktop, Desktop *newDesktop);
+
+    //! Parses a desktop entry; returns 0 if it shouldn't be shown
+    Desktop *createDesktop(const QString &fileName);
+
+    //! Appends rows for \a desktops
+    void insertApps(const QList<Desktop *> &desktops);
+
+    //! Removes the rows of \a desktops and deletes them
+    void removeApps(const QList<Desktop *> &desktops);
+
     QList<Desktop *> m_apps;
     QString m_customValue;
     QString m_type;
     QFileSystemWatcher *m_watcher;
+
+    //! The watched directories in the order of precedence
+    QStringList m_directories;
+
     QList<MenuItem *> m_categories;
     QHash<QString, MenuItem *> m_appsHash;
 
+    //! The shown desktop entries by their file paths
+    QHash<QString, Desktop *> m_appsByPath;
+
+    //! The shown desktop entries by their ids
+    QHash<QString, Desktop *> m_appsById;
+
+    //! The last listing of each watched directory
+    QHash<QString, DirectorySnapshot> m_snapshots;
+
+    //! Watches the parsing of the desktop files by resetApps()
+    QFutureWatcher<ParsedDesktop> *m_parser;
+
+    //! The index of the next parsed desktop file to add to the model
+    int m_nextParsedApp;
+
+    //! The watched directories of the desktop files being parsed, in the order of the files
+    QStringList m_parsedDirectories;
+
     Q_DISABLE_COPY(MenuModel)
 };
 
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include "snapshotcache.h"
+#include <string.h>
+
+//! The default memory budget of all the compressed snapshots in bytes
+static const int DEFAULT_MEMORY_BUDGET = 4 * 1024 * 1024;
+
+SnapshotCache *SnapshotCache::instance()
+{
+    static SnapshotCache snapshotCache;
+    return &snapshotCache;
+}
+
+SnapshotCache::SnapshotCache()
+    : usageCounter(0)
+    , memoryBudget_(DEFAULT_MEMORY_BUDGET)
+    , memoryUsage_(0)
+{
+}
+
+int SnapshotCache::memoryBudget() const
+{
+    return memoryBudget_;
+}
+
+void SnapshotCache::setMemoryBudget(int bytes)
+{
+    memoryBudget_ = bytes;
+    evictLeastRecentlyUsed();
+}
+
+int SnapshotCache::memoryUsage() const
+{
+    return memoryUsage_;
+}
+
+void SnapshotCache::storeSnapshot(Qt::HANDLE window, const QImage &image)
+{
+    removeSnapshot(window);
+    if (image.isNull()) {
+        return;
+    }
+
+    // Only the 32 bit formats are stored so that the scan lines need no padding
+    QImage::Format format = image.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32;
+    QImage convertedImage = image.format() == format ? image : image.convertToFormat(format);
+
+    Snapshot snapshot;
+    snapshot.data = qCompress(convertedImage.constBits(), convertedImage.byteCount());
+    snapshot.size = convertedImage.size();
+    snapshot.format = format;
+    snapshot.lastUsed = ++usageCounter;
+    snapshots.insert(window, snapshot);
+    memoryUsage_ += snapshot.data.size();
+
+    evictLeastRecentlyUsed();
+}
+
+QImage SnapshotCache::snapshot(Qt::HANDLE window)
+{
+    QHash<Qt::HANDLE, Snapshot>::iterator snapshot = snapshots.find(window);
+    if (snapshot == snapshots.end()) {
+        return QImage();
+    }
+
+    snapshot->lastUsed = ++usageCounter;
+    QByteArray data = qUncompress(snapshot->data);
+    QImage image(snapshot->size, snapshot->format);
+    if (data.size() != image.byteCount()) {
+        return QImage();
+    }
+
+    memcpy(image.bits(), data.constData(), data.size());
+    return image;
+}
+
+void SnapshotCache::removeSnapshot(Qt::HANDLE window)
+{
+    QHash<Qt::HANDLE, Snapshot>::iterator snapshot = snapshots.find(window);
+    if (snapshot != snapshots.end()) {
+        memoryUsage_ -= snapshot->data.size();
+        snapshots.erase(snapshot);
+    }
+}
+
+void SnapshotCache::evictLeastRecentlyUsed()
+{
+    while (memoryUsage_ > memoryBudget_ && !snapshots.isEmpty()) {
+        QHash<Qt::HANDLE, Snapshot>::iterator leastRecentlyUsed = snapshots.begin();
+        for (QHash<Qt::HANDLE, Snapshot>::iterator snapshot = snapshots.begin(); snapshot != snapshots.end(); ++snapshot) {
+            if (snapshot->lastUsed < leastRecentlyUsed->lastUsed) {
+                leastRecentlyUsed = snapshot;
+            }
+        }
+
+        memoryUsage_ -= leastRecentlyUsed->data.size();
+        snapshots.erase(leastRecentlyUsed);
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef SNAPSHOTCACHE_H
+#define SNAPSHOTCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+
+/*!
+ * A process wide cache of the last thumbnails of windows that are not
+ * mapped. The snapshots are kept compressed in client memory so that a
+ * preview of an unmapped window can be shown without any X traffic. All
+ * the snapshots share a single memory budget; when it is exceeded the least
+ * recently used snapshots are evicted.
+ */
+class SnapshotCache
+{
+public:
+    //! Returns the SnapshotCache instance
+    static SnapshotCache *instance();
+
+    //! Returns the memory budget of all the compressed snapshots in bytes
+    int memoryBudget() const;
+
+    //! Sets the memory budget of all the compressed snapshots in bytes
+    void setMemoryBudget(int bytes);
+
+    //! Returns the memory used by the compressed snapshots in bytes
+    int memoryUsage() const;
+
+    /*!
+     * Stores the snapshot of a window, replacing any previous one.
+     *
+     * \param window the window
+     * \param image the snapshot
+     */
+    void storeSnapshot(Qt::HANDLE window, const QImage &image);
+
+    /*!
+     * Returns the snapshot of a window and marks it as the most recently
+     * used one. The snapshot is decompressed on every call.
+     *
+     * \param window the window
+     * \return the snapshot or a null image if there is none
+     */
+    QImage snapshot(Qt::HANDLE window);
+
+    /*!
+     * Removes the snapshot of a window.
+     *
+     * \param window the window
+     */
+    void removeSnapshot(Qt::HANDLE window);
+
+private:
+    SnapshotCache();
+
+    struct Snapshot
+    {
+        Snapshot()
+            : format(QImage::Format_Invalid)
+            , lastUsed(0)
+        {}
+
+        //! The compressed pixel data
+        QByteArray data;
+
+        QSize size;
+        QImage::Format format;
+
+        //! The value of the usage counter when the snapshot was last used
+        quint64 lastUsed;
+    };
+
+    //! Evicts the least recently used snapshots until the budget is met
+    void evictLeastRecentlyUsed();
+
+    //! The snapshots by their windows
+    QHash<Qt::HANDLE, Snapshot> snapshots;
+
+    //! The usage counter for ordering the snapshots by their last use
+    quint64 usageCounter;
+
+    int memoryBudget_;
+    int memoryUsage_;
+};
+
+#endif // SNAPSHOTCACHE_H
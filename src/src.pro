@@ -27,33 +27,53 @@ CONFIG += qmake_cache target_qt
 
 # Input
 HEADERS += homeapplication.h \
+    atomcache.h \
     windowinfo.h \
+    windowpixmaplistener.h \
+    windowpixmapmanager.h \
     mainwindow.h \
     x11wrapper.h \
     menumodel.h \
     menuitem.h \
     desktop.h \
+    desktopcache.h \
+    desktopindex.h \
+    glxtexturepixmap.h \
     homescreenservice.h \
     homewindowmonitor.h \
     windowmonitor.h \
     xeventlistener.h \
+    xdamagelistener.h \
+    xerrortrap.h \
+    xshmimage.h \
     switchermodel.h \
+    thumbnailcache.h \
     qticonloader.h \
+    snapshotcache.h \
     switcherpixmapitem.h
 
 SOURCES += main.cpp \
+    atomcache.cpp \
     homeapplication.cpp \
     windowinfo.cpp \
+    windowpixmapmanager.cpp \
     mainwindow.cpp \
     x11wrapper.cpp \
     menumodel.cpp \
     menuitem.cpp \
     desktop.cpp \
+    desktopcache.cpp \
+    desktopindex.cpp \
+    glxtexturepixmap.cpp \
     homescreenservice.cpp \
     homewindowmonitor.cpp \
     xeventlistener.cpp \
+    xerrortrap.cpp \
+    xshmimage.cpp \
     switchermodel.cpp \
+    thumbnailcache.cpp \
     qticonloader.cpp \
+    snapshotcache.cpp \
     switcherpixmapitem.cpp
 
 RESOURCES += \
@@ -72,7 +92,7 @@ target.path += /usr/bin
 INSTALLS += target
 
 CONFIG += link_pkgconfig
-PKGCONFIG += xcomposite mlite xdamage
+PKGCONFIG += xcomposite mlite xdamage xext xfixes xrender x11-xcb xcb
 
 packagesExist(contentaction-0.1) {
     message("Using contentaction to launch applications")
@@ -11,45 +11,26 @@
 #include <QFileInfoList>
 #include <QFileSystemWatcher>
 #include <QRegExp>
+#include <QSet>
 #include <QX11Info>
 
 #include <mdesktopentry.h>
 #include "switchermodel.h"
 #include "desktop.h"
 #include "x11wrapper.h"
+#include "atomcache.h"
+#include "desktopindex.h"
 
-// TODO: generic atom cache would be nice
-static Atom clientListAtom;
-static Atom closeWindowAtom;
-static Atom windowTypeAtom;
-static Atom windowStateAtom;
-static Atom activeWindowAtom;
-static Atom skipTaskbarAtom;
-static Atom windowTypeDesktopAtom;
-static Atom windowTypeNotificationAtom;
-static Atom windowTypeDockAtom;
-static Atom windowTypeNormalAtom;
-static Atom utf8StringAtom;
-static Atom windowPidAtom;
-static Atom iconGeometryAtom;
+// By default coalesce the updates requested within one frame
+static const int DEFAULT_UPDATE_LATENCY = 16;
 
 SwitcherModel::SwitcherModel(QObject *parent)
     : QAbstractItemModel(parent)
+    , m_activeWindow(0)
+    , m_requestedUpdates(0)
+    , m_coalescedUpdates(0)
+    , m_executedUpdates(0)
 {
-    clientListAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_CLIENT_LIST", False);
-    closeWindowAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_CLOSE_WINDOW", False);
-    windowTypeAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_WINDOW_TYPE", False);
-    windowStateAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_STATE", False);
-    activeWindowAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_ACTIVE_WINDOW", False);
-    skipTaskbarAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_STATE_SKIP_TASKBAR", False);
-    windowTypeDesktopAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_WINDOW_TYPE_DESKTOP", False);
-    windowTypeNotificationAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_WINDOW_TYPE_NOTIFICATION", False);
-    windowTypeDockAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_WINDOW_TYPE_DOCK", False);
-    windowTypeNormalAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_WINDOW_TYPE_NORMAL", False);
-    utf8StringAtom = X11Wrapper::XInternAtom(QX11Info::display(), "UTF8_STRING", False);
-    windowPidAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_PID", False);
-    iconGeometryAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_ICON_GEOMETRY", False);
-
     QHash<int, QByteArray> roles;
     roles[id]="pid";
     roles[name]="name";
@@ -60,132 +41,84 @@ SwitcherModel::SwitcherModel(QObject *parent)
     roles[nodisplay]="nodisplay";
     roles[object]="object";
     roles[windowId] = "windowId";
+    roles[active] = "active";
 
     setRoleNames(roles);
+
+    m_updateTimer.setSingleShot(true);
+    m_updateTimer.setInterval(DEFAULT_UPDATE_LATENCY);
+    connect(&m_updateTimer, SIGNAL(timeout()), this, SLOT(updateWindowList()));
+    connect(DesktopIndex::instance(), SIGNAL(desktopsChanged()), this, SLOT(desktopsChanged()));
+
+    updateActiveWindow();
 }
 
 SwitcherModel::~SwitcherModel()
 {
 }
 
-/*
-static const char *appAtomNames[ATOM_COUNT] = {
-    "_MEEGO_ORIENTATION",
-    "_MEEGO_INHIBIT_SCREENSAVER",
-    "_MEEGO_TABLET_NOTIFY",
-    "_MEEGO_STACKING_LAYER",
-    "_MEEGOTOUCH_SKIP_ANIMATIONS",
-    "_NET_ACTIVE_WINDOW",
-    "_NET_CLIENT_LIST",
-    "_NET_CLOSE_WINDOW",
-    "_NET_WM_WINDOW_TYPE",
-    "_NET_WM_WINDOW_TYPE_NORMAL",
-    "_NET_WM_WINDOW_TYPE_DESKTOP",
-    "_NET_WM_WINDOW_TYPE_NOTIFICATION",
-    "_NET_WM_WINDOW_TYPE_DOCK",
-    "_NET_WM_STATE_SKIP_TASKBAR",
-    "_NET_WM_STATE",
-    "_NET_WM_PID",
-    "_NET_WM_ICON_GEOMETRY",
-    "_NET_WM_ICON_NAME",
-    "Backlight",
-    "BACKLIGHT",
-    "UTF8_STRING",
-    "WM_CHANGE_STATE",
-    "_MEEGO_SYSTEM_DIALOG"
-*/
-
 bool SwitcherModel::handleXEvent(const XEvent &event)
 {
     if (event.type == PropertyNotify &&
         event.xproperty.window == DefaultRootWindow(QX11Info::display()) &&
-        event.xproperty.atom == clientListAtom)
+        event.xproperty.atom == AtomCache::atom(AtomCache::NetClientList))
     {
-        updateWindowList();
+        scheduleWindowListUpdate();
         return true;
     }
     else if (event.type == ClientMessage &&
-             event.xclient.message_type == closeWindowAtom)
+             event.xclient.message_type == AtomCache::atom(AtomCache::NetCloseWindow))
     {
         qDebug() << Q_FUNC_INFO << "Got close WindowInfo event for " << event.xclient.window;
         if (!windowsBeingClosed.contains(event.xclient.window))
         {
             windowsBeingClosed.append(event.xclient.window);
         }
-        updateWindowList();
+        scheduleWindowListUpdate();
         return true;
     }
     else if (event.type == PropertyNotify &&
-             (event.xproperty.atom == windowTypeAtom ||
-              event.xproperty.atom == windowStateAtom))
+             event.xproperty.window == DefaultRootWindow(QX11Info::display()) &&
+             event.xproperty.atom == AtomCache::atom(AtomCache::NetActiveWindow))
     {
-        updateWindowList();
-        return true;
-    }
-    else if (event.type == PropertyNotify &&
-             event.xproperty.atom == activeWindowAtom)
-    {
-        updateWindowList();
+        updateActiveWindow();
         return true;
     }
 
     return false;
 }
 
-static QVector<Atom> getNetWmState(Display *display, Window window)
+void SwitcherModel::scheduleWindowListUpdate()
 {
-    QVector<Atom> atomList;
-
-    Atom actualType;
-    int actualFormat;
-    ulong propertyLength;
-    ulong bytesLeft;
-    uchar *propertyData = 0;
-
-    // Step 1: Get the size of the list
-    bool result = XGetWindowProperty(display, window, windowStateAtom, 0, 0,
-                                     false, XA_ATOM, &actualType,
-                                     &actualFormat, &propertyLength,
-                                     &bytesLeft, &propertyData);
-    if (result == Success && actualType == XA_ATOM && actualFormat == 32)
-    {
-        atomList.resize(bytesLeft / sizeof(Atom));
-        XFree(propertyData);
-
-        // Step 2: Get the actual list
-        if (XGetWindowProperty(display, window, windowStateAtom, 0,
-                               atomList.size(), false, XA_ATOM,
-                               &actualType, &actualFormat,
-                               &propertyLength, &bytesLeft,
-                               &propertyData) == Success)
-        {
-            if (propertyLength != (ulong)atomList.size())
-            {
-                atomList.resize(propertyLength);
-            }
-
-            if (!atomList.isEmpty())
-            {
-                memcpy(atomList.data(), propertyData,
-                       atomList.size() * sizeof(Atom));
-            }
-            XFree(propertyData);
-        }
-        else
-        {
-            qWarning("Unable to retrieve window properties: %i", (int) window);
-            atomList.clear();
-        }
+    m_requestedUpdates++;
+    if (m_updateTimer.isActive()) {
+        m_coalescedUpdates++;
+    } else {
+        m_updateTimer.start();
     }
+    emit updateStatisticsChanged();
+}
+
+int SwitcherModel::updateLatency() const
+{
+    return m_updateTimer.interval();
+}
 
-    return atomList;
+void SwitcherModel::setUpdateLatency(int latency)
+{
+    m_updateTimer.setInterval(qMax(0, latency));
 }
 
 void SwitcherModel::updateWindowList()
 {
-    qDebug() << Q_FUNC_INFO << "Updating window list";
+    // A pending scheduled update would only repeat this one
+    m_updateTimer.stop();
+    m_executedUpdates++;
+    emit updateStatisticsChanged();
+
+    qDebug() << Q_FUNC_INFO << "Updating window list" << "(requested" << m_requestedUpdates
+             << "coalesced" << m_coalescedUpdates << "executed" << m_executedUpdates << ")";
     Display *dpy = QX11Info::display();
-    XWindowAttributes wAttributes;
     Atom actualType;
     int actualFormat;
     unsigned long numWindowItems, bytesLeft;
@@ -193,7 +126,7 @@ void SwitcherModel::updateWindowList()
 
     int result = XGetWindowProperty(dpy,
                                     DefaultRootWindow(dpy),
-                                    clientListAtom,
+                                    AtomCache::atom(AtomCache::NetClientList),
                                     0, 0x7fffffff,
                                     false, XA_WINDOW,
                                     &actualType,
@@ -206,135 +139,67 @@ void SwitcherModel::updateWindowList()
         return;
 
     qDebug() << "Read list of " << numWindowItems << " windows";
-    QList<WindowInfo *> windowList;
+    QList<Window> clientWindows;
     Window *wins = (Window *)windowData;
-
     for (unsigned int i = 0; i < numWindowItems; i++)
+        clientWindows.append(wins[i]);
+    XFree(wins);
+
+    // The properties of the windows seen in earlier scans are kept up to
+    // date by WindowInfo itself, so only check whether those windows are
+    // viewable. Everything is fetched for the new windows.
+    QList<Window> knownWindows;
+    QList<Window> newWindows;
+    foreach (Window window, clientWindows)
     {
-        if (XGetWindowAttributes(dpy, wins[i], &wAttributes) != 0
-            && wAttributes.width > 0 &&
-            wAttributes.height > 0 && wAttributes.c_class == InputOutput &&
-            wAttributes.map_state != IsUnmapped)
+        if (m_clientWindows.contains(window))
+            knownWindows.append(window);
+        else
+            newWindows.append(window);
+    }
+
+    QHash<Window, X11Wrapper::WindowProperties> scannedWindows;
+    foreach (const X11Wrapper::WindowProperties &properties, X11Wrapper::scanWindows(dpy, knownWindows, X11Wrapper::ScanAttributes) +
+                                                              X11Wrapper::scanWindows(dpy, newWindows))
+        scannedWindows.insert(properties.window, properties);
+
+    QList<WindowInfo *> windowList;
+    foreach (Window window, clientWindows)
+    {
+        const X11Wrapper::WindowProperties properties = scannedWindows.value(window);
+        WindowInfo *wi = m_clientWindows.value(window);
+
+        // Minimized windows are unmapped but stay in the switcher showing their last thumbnail
+        bool hidden = wi != NULL ? wi->flags().testFlag(WindowInfo::HiddenState) :
+                                   properties.states.contains(AtomCache::atom(AtomCache::NetWmStateHidden));
+        if (!properties.viewable && !(properties.exists && hidden))
+            continue;
+
+        if (wi == NULL)
+            wi = WindowInfo::windowFor(properties);
+
+        if (!m_clientWindows.contains(window))
         {
-            unsigned char *typeData = NULL;
-            unsigned long numTypeItems;
-
-            // _NET_WM_PID
-            unsigned char *propPid = 0;
-            result = XGetWindowProperty(dpy,
-                                        wins[i],
-                                        windowPidAtom,
-                                        0L, (long)BUFSIZ, false,
-                                        XA_CARDINAL,
-                                        &actualType,
-                                        &actualFormat,
-                                        &numTypeItems,
-                                        &bytesLeft,
-                                        &propPid);
-            if (result == Success && propPid != 0)
-            {
-                unsigned long pid = 0;
-                pid = *((unsigned long *)propPid);
-                XFree(propPid);
-
-                // TODO: use this to tie to .desktop entries in launcher
-                Q_UNUSED(pid);
-            }
-
-            result = XGetWindowProperty(dpy,
-                                        wins[i],
-                                        windowTypeAtom,
-                                        0L, 16L, false,
-                                        XA_ATOM,
-                                        &actualType,
-                                        &actualFormat,
-                                        &numTypeItems,
-                                        &bytesLeft,
-                                        &typeData);
-            if (result == Success)
-            {
-                Atom *type = (Atom *)typeData;
-
-                bool includeInWindowList = false;
-
-                // plain Xlib windows do not have a type
-                if (numTypeItems == 0)
-                    includeInWindowList = true;
-                for (unsigned int n = 0; n < numTypeItems; n++)
-                {
-                    if (type[n] == windowTypeDesktopAtom ||
-                        type[n] == windowTypeNotificationAtom ||
-                        type[n] == windowTypeDockAtom)
-                    {
-                        includeInWindowList = false;
-                        break;
-                    }
-                    if (type[n] == windowTypeNormalAtom)
-                    {
-                        includeInWindowList = true;
-                    }
-                }
-
-                if (includeInWindowList)
-                {
-                    if (getNetWmState(dpy, wins[i]).contains(skipTaskbarAtom))
-                    {
-                        includeInWindowList = false;
-                    }
-                }
-
-                if (includeInWindowList)
-                {
-                    XTextProperty textProperty;
-                    QString title;
-
-                    if (XGetWMName(dpy, wins[i], &textProperty) != 0)
-                    {
-                        title = QString((const char *)(textProperty.value));
-                        XFree(textProperty.value);
-                    }
-
-                    // Get window icon
-                    XWMHints *wmhints = XGetWMHints(dpy, wins[i]);
-                    if (wmhints != NULL)
-                    {
-                        Pixmap pixmap;
-                        pixmap = wmhints->icon_pixmap;
-                        XFree(wmhints);
-
-                        // TODO: set pixmap
-                        Q_UNUSED(pixmap);
-                    }
-
-                    if (!windowsBeingClosed.contains(wins[i]))
-                    {
-                        unsigned int geom[4];
-                        geom[0] = 0; // x
-                        geom[1] = 0; // y
-                        geom[2] = 100; // width
-                        geom[3] = 100; // height
-                        XChangeProperty(QX11Info::display(),
-                                        wins[i],
-                                        iconGeometryAtom,
-                                        XA_CARDINAL,
-                                        sizeof(unsigned int) * 8,
-                                        PropModeReplace,
-                                        (unsigned char *)&geom, 4);
-
-                        WindowInfo *wi = WindowInfo::windowFor(wins[i]);
-                        windowList.append(wi);
-                    }
-                    else
-                    {
-                        windowsStillBeingClosed.append(wins[i]);
-                    }
-                }
-                XFree(typeData);
-            }
+            m_clientWindows.insert(window, wi);
+            DesktopIndex::instance()->addWindow(wi);
+            connect(wi, SIGNAL(titleChanged()), this, SLOT(windowTitleChanged()));
+            connect(wi, SIGNAL(typesChanged()), this, SLOT(windowTypesOrStatesChanged()));
+            connect(wi, SIGNAL(statesChanged()), this, SLOT(windowTypesOrStatesChanged()));
         }
-    }
 
-    XFree(wins);
+        if (!wi->belongsInSwitcher())
+            continue;
+
+        // _NET_WM_ICON_GEOMETRY is maintained by the thumbnails showing the window
+        if (!windowsBeingClosed.contains(window))
+        {
+            windowList.append(wi);
+        }
+        else
+        {
+            windowsStillBeingClosed.append(window);
+        }
+    }
 
     for (int i = windowsBeingClosed.count() - 1; i >= 0; i--)
     {
@@ -345,18 +210,164 @@ void SwitcherModel::updateWindowList()
         }
     }
 
-    qDebug() << Q_FUNC_INFO << "Deleting WindowInfos for " << windowsStillBeingClosed;
-    foreach (Window wid, windowsStillBeingClosed) {
-        WindowInfo *wi = WindowInfo::windowFor(wid);
-        delete wi;
+    // Update the rows before deleting anything they may still refer to
+    updateApps(mostRecentlyUsedOrder(windowList));
+
+    // Forget the windows that have disappeared from the client list. Their
+    // rows are gone by now; a window that still has a row is kept.
+    QSet<Window> clientWindowSet = clientWindows.toSet();
+    QSet<Window> windowsToForget;
+    foreach (Window wid, m_clientWindows.keys()) {
+        if (!clientWindowSet.contains(wid) && !m_rows.contains(wid))
+            windowsToForget.insert(wid);
+    }
+
+    qDebug() << Q_FUNC_INFO << "Deleting WindowInfos for " << windowsToForget;
+    foreach (Window wid, windowsToForget) {
+        if (WindowInfo *wi = m_clientWindows.take(wid))
+            DesktopIndex::instance()->removeWindow(wi);
+        delete WindowInfo::existingWindowFor(wid);
     }
 
     windowsStillBeingClosed.clear();
+}
+
+QList<WindowInfo *> SwitcherModel::mostRecentlyUsedOrder(const QList<WindowInfo *> &windowList) const
+{
+    QSet<WindowInfo *> listedWindows = windowList.toSet();
+    QList<WindowInfo *> orderedList;
+
+    // _NET_CLIENT_LIST is in initial mapping order so the newest window is the last one
+    for (int i = windowList.count() - 1; i >= 0; i--) {
+        if (!m_rows.contains(windowList.at(i)->window()))
+            orderedList.append(windowList.at(i));
+    }
+
+    foreach (WindowInfo *wi, m_windows) {
+        if (listedWindows.contains(wi))
+            orderedList.append(wi);
+    }
+
+    for (int i = 1; i < orderedList.count(); i++) {
+        if (orderedList.at(i)->window() == m_activeWindow) {
+            orderedList.move(i, 0);
+            break;
+        }
+    }
+
+    return orderedList;
+}
+
+void SwitcherModel::updateActiveWindow()
+{
+    Display *dpy = QX11Info::display();
+    Atom actualType;
+    int actualFormat;
+    unsigned long numItems, bytesLeft;
+    unsigned char *data = NULL;
+    Window activeWindow = 0;
+
+    if (X11Wrapper::XGetWindowProperty(dpy, DefaultRootWindow(dpy), AtomCache::atom(AtomCache::NetActiveWindow),
+                                       0, 1, False, XA_WINDOW, &actualType, &actualFormat,
+                                       &numItems, &bytesLeft, &data) == Success && data != NULL) {
+        if (numItems > 0)
+            activeWindow = *(Window *)data;
+        X11Wrapper::XFree(data);
+    }
+
+    if (activeWindow == m_activeWindow)
+        return;
+
+    Window previousActiveWindow = m_activeWindow;
+    m_activeWindow = activeWindow;
+    emitWindowDataChanged(previousActiveWindow);
+
+    int row = m_rows.value(activeWindow, -1);
+    if (row > 0) {
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), 0);
+        m_windows.move(row, 0);
+        updateRows(0, row);
+        endMoveRows();
+    }
+    emitWindowDataChanged(activeWindow);
+}
 
-    // TODO: don't reset whole model
-    beginResetModel();
-    m_windows = windowList;
-    endResetModel();
+void SwitcherModel::emitWindowDataChanged(Window window)
+{
+    int row = m_rows.value(window, -1);
+    if (row >= 0) {
+        QModelIndex changedIndex = index(row, 0);
+        emit dataChanged(changedIndex, changedIndex);
+    }
+}
+
+void SwitcherModel::updateRows(int first, int last)
+{
+    for (int row = first; row <= last; row++)
+        m_rows.insert(m_windows.at(row)->window(), row);
+}
+
+void SwitcherModel::desktopsChanged()
+{
+    if (!m_windows.isEmpty())
+        emit dataChanged(index(0, 0), index(m_windows.count() - 1, 0));
+}
+
+void SwitcherModel::windowTitleChanged()
+{
+    emitWindowDataChanged(static_cast<WindowInfo *>(sender())->window());
+}
+
+void SwitcherModel::windowTypesOrStatesChanged()
+{
+    // Only a change in whether the window belongs to the switcher requires a rescan
+    WindowInfo *wi = static_cast<WindowInfo *>(sender());
+    if (m_rows.contains(wi->window()) != wi->belongsInSwitcher())
+        scheduleWindowListUpdate();
+}
+
+void SwitcherModel::updateApps(const QList<WindowInfo *> &windowList)
+{
+    // Remove the rows of the windows that are no longer listed, a contiguous run at a time
+    QSet<WindowInfo *> listedWindows = windowList.toSet();
+    int row = m_windows.count() - 1;
+    while (row >= 0) {
+        if (listedWindows.contains(m_windows.at(row))) {
+            row--;
+            continue;
+        }
+
+        int last = row;
+        while (row > 0 && !listedWindows.contains(m_windows.at(row - 1)))
+            row--;
+
+        beginRemoveRows(QModelIndex(), row, last);
+        for (int i = last; i >= row; i--)
+            m_rows.remove(m_windows.takeAt(i)->window());
+        updateRows(row, m_windows.count() - 1);
+        endRemoveRows();
+        row--;
+    }
+
+    // Move the remaining rows to their new positions and insert the new windows
+    for (row = 0; row < windowList.count(); row++) {
+        WindowInfo *wi = windowList.at(row);
+        if (row < m_windows.count() && m_windows.at(row) == wi)
+            continue;
+
+        int oldRow = m_rows.value(wi->window(), -1);
+        if (oldRow >= 0) {
+            beginMoveRows(QModelIndex(), oldRow, oldRow, QModelIndex(), row);
+            m_windows.move(oldRow, row);
+            updateRows(row, oldRow);
+            endMoveRows();
+        } else {
+            beginInsertRows(QModelIndex(), row, row);
+            m_windows.insert(row, wi);
+            updateRows(row, m_windows.count() - 1);
+            endInsertRows();
+        }
+    }
 }
 
 QModelIndex SwitcherModel::index(int row, int column, const QModelIndex &parent) const
@@ -395,12 +406,32 @@ QVariant SwitcherModel::data(const QModelIndex& index, int role) const
     switch (role) {
         case name:
             return i->title();
+        case id:
+        case exec:
+        case icon:
+        case comment:
+        case filename: {
+            Desktop *desktop = DesktopIndex::instance()->desktopFor(i);
+            if (desktop == NULL)
+                break;
+            if (role == id)
+                return desktop->id();
+            if (role == exec)
+                return desktop->exec();
+            if (role == icon)
+                return "file:///" + desktop->icon();
+            if (role == comment)
+                return desktop->comment();
+            return desktop->filename();
+        }
         case windowId: {
             qulonglong wid = i->window();
             return wid;
         }
         case object:
             return QVariant::fromValue<QObject *>(i);
+        case active:
+            return i->window() == m_activeWindow;
         default:
             break;
     }
@@ -420,7 +451,7 @@ void SwitcherModel::windowToFront(qulonglong window)
     memset(&ev, 0, sizeof(ev));
     ev.xclient.type         = ClientMessage;
     ev.xclient.window       = window;
-    ev.xclient.message_type = activeWindowAtom;
+    ev.xclient.message_type = AtomCache::atom(AtomCache::NetActiveWindow);
     ev.xclient.format       = 32;
     ev.xclient.data.l[0]    = 1;
     ev.xclient.data.l[1]    = CurrentTime;
@@ -436,15 +467,16 @@ void SwitcherModel::closeWindow(qulonglong window)
     memset(&ev, 0, sizeof(ev));
     ev.xclient.type         = ClientMessage;
     ev.xclient.window       = window;
-    ev.xclient.message_type = closeWindowAtom;
+    ev.xclient.message_type = AtomCache::atom(AtomCache::NetCloseWindow);
     ev.xclient.format       = 32;
     ev.xclient.data.l[0]    = CurrentTime;
     ev.xclient.data.l[1]    = rootWin;
     X11Wrapper::XSendEvent(QX11Info::display(), rootWin, False, SubstructureRedirectMask, &ev);
     qDebug() << Q_FUNC_INFO << "Closed " << window;
 
-    if (!windowsStillBeingClosed.contains(window))
-        windowsStillBeingClosed.append(window);
+    // Hide the window until it has left the client list
+    if (!windowsBeingClosed.contains(window))
+        windowsBeingClosed.append(window);
 
     // Close also the window this one is transient for, if any
     WindowInfo *windowInfo = WindowInfo::windowFor(window);
@@ -452,8 +484,8 @@ void SwitcherModel::closeWindow(qulonglong window)
         qDebug() << Q_FUNC_INFO << "Closing transient " << windowInfo->transientFor();
         closeWindow(windowInfo->transientFor());
     } else {
-        qDebug() << Q_FUNC_INFO << "Updating WindowInfo list, deleting " << windowsBeingClosed;
-        updateWindowList();
+        qDebug() << Q_FUNC_INFO << "Updating WindowInfo list, closing " << windowsBeingClosed;
+        scheduleWindowListUpdate();
     }
 
 
@@ -13,6 +13,7 @@
 #include <QtDeclarative>
 #include <QAbstractItemModel>
 #include <QHash>
+#include <QTimer>
 #include "menuitem.h"
 #include "windowinfo.h"
 #include "desktop.h"
@@ -23,6 +24,10 @@ class QFileSystemWatcher;
 class SwitcherModel : public QAbstractItemModel, XEventListener
 {
     Q_OBJECT
+    Q_PROPERTY(int updateLatency READ updateLatency WRITE setUpdateLatency)
+    Q_PROPERTY(int requestedUpdates READ requestedUpdates NOTIFY updateStatisticsChanged)
+    Q_PROPERTY(int coalescedUpdates READ coalescedUpdates NOTIFY updateStatisticsChanged)
+    Q_PROPERTY(int executedUpdates READ executedUpdates NOTIFY updateStatisticsChanged)
 
 public:
     explicit SwitcherModel(QObject *parent = 0);
@@ -38,12 +43,45 @@ public:
         filename,
         nodisplay,
         object,
-        windowId
+        windowId,
+        active
     };
 
     virtual bool handleXEvent(const XEvent &event);
-    void updateWindowList();
-    void updateApps(const QList<WindowInfo> &windowList);
+
+    /*!
+     * Requests the window list to be updated. All the requests made within
+     * the update latency are coalesced into a single updateWindowList().
+     */
+    void scheduleWindowListUpdate();
+
+    //! Returns the maximum time in milliseconds a scheduled update may be delayed
+    int updateLatency() const;
+
+    //! Sets the maximum time in milliseconds a scheduled update may be delayed
+    void setUpdateLatency(int latency);
+
+    //! Returns the number of times a window list update has been scheduled
+    int requestedUpdates() const { return m_requestedUpdates; }
+
+    //! Returns the number of scheduled updates that were merged into an already pending one
+    int coalescedUpdates() const { return m_coalescedUpdates; }
+
+    //! Returns the number of times the window list has actually been updated
+    int executedUpdates() const { return m_executedUpdates; }
+
+    /*!
+     * Updates the model to contain \a windowList. Only the rows that have
+     * been added, removed or moved are signalled to the views so that
+     * the delegates of the unchanged rows are preserved.
+     */
+    void updateApps(const QList<WindowInfo *> &windowList);
+
+    /*!
+     * Reads _NET_ACTIVE_WINDOW and moves the newly activated window to the
+     * front of the switcher. Only the affected rows are signalled.
+     */
+    void updateActiveWindow();
 
     ///overrides from QAbstractModel:
     QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
@@ -57,11 +95,59 @@ public:
     // stuck onto the model randomly
     Q_INVOKABLE void closeWindow(qulonglong window);
     Q_INVOKABLE void windowToFront(qulonglong window);
+
+signals:
+    //! Emitted when any of the window list update statistics has changed
+    void updateStatisticsChanged();
+
+public slots:
+    void updateWindowList();
+
+private slots:
+    //! Signals the row of the sending WindowInfo as changed
+    void windowTitleChanged();
+
+    //! Rescans the window list if the sending WindowInfo entered or left the switcher
+    void windowTypesOrStatesChanged();
+
+    //! Signals all the rows as changed since their desktop entries may have changed
+    void desktopsChanged();
+
 private:
+    /*!
+     * Orders \a windowList by recency of use: new windows first, newest
+     * first, then the already listed windows in their current order.
+     * The active window is always the first one.
+     */
+    QList<WindowInfo *> mostRecentlyUsedOrder(const QList<WindowInfo *> &windowList) const;
+
+    //! Emits dataChanged for the row of the given window, if it is listed
+    void emitWindowDataChanged(Window window);
+
+    //! Updates m_rows for the rows from \a first to \a last
+    void updateRows(int first, int last);
+
     QList<Window> windowsBeingClosed;
     QList<WindowInfo *> m_windows;
     QList<Window> windowsStillBeingClosed;
 
+    //! The rows of the windows in m_windows
+    QHash<Window, int> m_rows;
+
+    //! The WindowInfos of all the viewable or minimized windows in _NET_CLIENT_LIST
+    QHash<Window, WindowInfo *> m_clientWindows;
+
+    //! The current _NET_ACTIVE_WINDOW
+    Window m_activeWindow;
+
+    //! Timer for running the scheduled window list update
+    QTimer m_updateTimer;
+
+    //! Statistics on the scheduled window list updates
+    int m_requestedUpdates;
+    int m_coalescedUpdates;
+    int m_executedUpdates;
+
     Q_DISABLE_COPY(SwitcherModel)
 };
 
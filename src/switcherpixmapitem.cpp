@@ -18,46 +18,95 @@
 ****************************************************************************/
 
 #include <QApplication>
+#include <QGraphicsScene>
+#include <QGraphicsView>
 #include <QPainter>
+#include <QPaintEngine>
 #include <QTimer>
 #include <QX11Info>
 
 #include "switcherpixmapitem.h"
 #include "x11wrapper.h"
+#include "atomcache.h"
+#include "thumbnailcache.h"
+#include "windowpixmapmanager.h"
+#include "snapshotcache.h"
+#include "glxtexturepixmap.h"
+#include "xshmimage.h"
+#ifdef BENCHMARKS_ON
+#include <QDebug>
+#include <QHash>
+#include <time.h>
+#endif
 
-// TODO: disable damage event processing when not on the screen
-// TODO: handle visibility/obscuring invalidating pixmaps
+// TODO: handle obscuring invalidating pixmaps
 
 const int ICON_GEOMETRY_UPDATE_INTERVAL = 200;
-Atom iconGeometryAtom = 0;
-#ifdef Q_WS_X11
-unsigned char xErrorCode = Success;
-#endif
 
-#ifdef Q_WS_X11
-static int handleXError(Display *, XErrorEvent *event)
+#ifdef BENCHMARKS_ON
+//! The number of thumbnail paints over which the paint time is averaged
+const int PAINT_BENCHMARK_SAMPLES = 100;
+
+static qint64 benchmarkTime()
 {
-    xErrorCode = event->error_code;
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return qint64(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
 
-    return 0;
+//! Reports the average time taken to paint a thumbnail with each path
+static void benchmarkPaint(const char *path, qint64 nsecs)
+{
+    static QHash<QByteArray, QPair<int, qint64> > paintTimes;
+    QPair<int, qint64> &paintTime = paintTimes[path];
+    paintTime.first++;
+    paintTime.second += nsecs;
+    if (paintTime.first == PAINT_BENCHMARK_SAMPLES) {
+        qDebug() << "SwitcherPixmapItem: average paint time with" << path << paintTime.second / paintTime.first / 1000 << "us";
+        paintTime = qMakePair(0, qint64(0));
+    }
 }
 #endif
 
 struct SwitcherPixmapItem::Private
 {
     Private()
-        : xWindowPixmapIsValid(false)
-        , xWindowPixmap(0)
-        , xWindowPixmapDamage(0)
+        : listening(false)
+        , thumbnailIsValid(false)
+        , texturePixmap(0)
+        , shmImage(0)
+        , shmImageKey(0)
         , windowId(0)
+        , inViewport(true)
     {}
 
-    bool xWindowPixmapIsValid;
-    Pixmap xWindowPixmap;
-    Damage xWindowPixmapDamage;
-    QPixmap qWindowPixmap;
+    //! Whether the item is listening to the composite pixmap of the window
+    bool listening;
+
+    //! Whether the cached thumbnail is up to date with the window pixmap
+    bool thumbnailIsValid;
+
+    //! The area of the window damaged since the thumbnail was last rendered
+    QRegion thumbnailDamage;
+
+    //! The snapshot of the window shown while the window pixmap isn't available
+    QImage snapshot;
+
+    //! The thumbnail bound as a GL texture when painting with OpenGL
+    GLXTexturePixmap *texturePixmap;
+
+    //! The thumbnail read through shared memory when painting with a client side engine and the cache key of the thumbnail read
+    XShmImage *shmImage;
+    qint64 shmImageKey;
+
     int windowId;
     QTimer updateXWindowIconGeometryTimer;
+
+    //! The _NET_WM_ICON_GEOMETRY last written to the window
+    QRect xWindowIconGeometry;
+
+    //! Whether the item is visible in the viewport of the view
+    bool inViewport;
 };
 
 SwitcherPixmapItem::SwitcherPixmapItem()
@@ -65,126 +114,179 @@ SwitcherPixmapItem::SwitcherPixmapItem()
     , d(new Private)
 {
     setFlag(QGraphicsItem::ItemHasNoContents, false);
-
-    if (iconGeometryAtom == 0)
-        iconGeometryAtom = X11Wrapper::XInternAtom(QX11Info::display(), "_NET_WM_ICON_GEOMETRY", false);
+    setFlag(QGraphicsItem::ItemSendsScenePositionChanges, true);
 
     d->updateXWindowIconGeometryTimer.setSingleShot(true);
     d->updateXWindowIconGeometryTimer.setInterval(ICON_GEOMETRY_UPDATE_INTERVAL);
-    connect(&d->updateXWindowIconGeometryTimer, SIGNAL(timeout()), SLOT(updateXWindowIconGeomery()));
-
-    connect(qApp, SIGNAL(damageEvent(Qt::HANDLE &, short &, short &, unsigned short &, unsigned short &)), this, SLOT(damageEvent(Qt::HANDLE &, short &, short &, unsigned short &, unsigned short &)));
+    connect(&d->updateXWindowIconGeometryTimer, SIGNAL(timeout()), SLOT(updateXWindowIconGeometry()));
 }
 
 SwitcherPixmapItem::~SwitcherPixmapItem()
 {
-    destroyDamage();
-    if (d->xWindowPixmap)
-        X11Wrapper::XFreePixmap(QX11Info::display(), d->xWindowPixmap);
+    stopListening();
     delete d;
 }
 
-void SwitcherPixmapItem::damageEvent(Qt::HANDLE &damage, short &x, short &y, unsigned short &width, unsigned short &height)
+void SwitcherPixmapItem::windowPixmapChanged()
 {
-    Q_UNUSED(x);
-    Q_UNUSED(y);
-    Q_UNUSED(width);
-    Q_UNUSED(height);
-#ifdef Q_WS_X11
-    if (d->xWindowPixmapDamage == damage) {
-        X11Wrapper::XDamageSubtract(QX11Info::display(), d->xWindowPixmapDamage, None, None);
-        update();
+    releaseThumbnail();
+    update();
+}
+
+void SwitcherPixmapItem::windowPixmapDamaged(const QRegion &region)
+{
+    // Repaint only the part of the thumbnail the damage maps to
+    ThumbnailCache *thumbnailCache = ThumbnailCache::instance();
+    QSize size = boundingRect().size().toSize();
+    foreach (const QRect &rect, region.rects()) {
+        QRect thumbnailRect = thumbnailCache->mapToThumbnail(d->windowId, size, rect);
+        if (thumbnailRect.isNull()) {
+            update();
+            break;
+        }
+        update(thumbnailRect);
+    }
+
+    d->thumbnailDamage += region;
+}
+
+void SwitcherPixmapItem::thumbnailReleased(Qt::HANDLE thumbnail)
+{
+    // The texture would keep the freed thumbnail alive on the X server
+    if (d->texturePixmap != 0 && d->texturePixmap->pixmap() == thumbnail) {
+        delete d->texturePixmap;
+        d->texturePixmap = 0;
     }
-#else
-    Q_UNUSED(damage);
-#endif
+}
+
+QRect SwitcherPixmapItem::iconGeometry() const
+{
+    // The icon geometry is the position of the thumbnail on the screen
+    QGraphicsScene *graphicsScene = scene();
+    if (graphicsScene == NULL || graphicsScene->views().isEmpty())
+        return QRect();
+
+    QGraphicsView *view = graphicsScene->views().first();
+    QRect viewRect = view->mapFromScene(sceneBoundingRect()).boundingRect();
+    return viewRect.translated(view->viewport()->mapToGlobal(QPoint(0, 0)));
 }
 
 void SwitcherPixmapItem::updateXWindowIconGeometry()
 {
-    qDebug() << Q_FUNC_INFO << "Implement me!";
+    if (d->windowId == 0)
+        return;
+
+    QRect geometry = iconGeometry();
+    if (geometry.isEmpty() || geometry == d->xWindowIconGeometry)
+        return;
+
+    unsigned long geom[4];
+    geom[0] = geometry.x();
+    geom[1] = geometry.y();
+    geom[2] = geometry.width();
+    geom[3] = geometry.height();
+    X11Wrapper::XChangeProperty(QX11Info::display(), d->windowId, AtomCache::atom(AtomCache::NetWmIconGeometry),
+                                XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&geom, 4);
+    d->xWindowIconGeometry = geometry;
 }
 
 void SwitcherPixmapItem::updateXWindowIconGeometryIfNecessary()
 {
-    qDebug() << Q_FUNC_INFO << "Implement me!";
+    // Batch the changes so that an item being moved around writes the property only once
+    if (d->windowId != 0 && !d->updateXWindowIconGeometryTimer.isActive() && iconGeometry() != d->xWindowIconGeometry)
+        d->updateXWindowIconGeometryTimer.start();
 }
 
-void SwitcherPixmapItem::destroyDamage()
+bool SwitcherPixmapItem::isInViewport() const
 {
-    if (d->xWindowPixmapDamage != 0) {
-        X11Wrapper::XDamageDestroy(QX11Info::display(), d->xWindowPixmapDamage);
-        d->xWindowPixmapDamage = 0;
-    }
+    QGraphicsScene *graphicsScene = scene();
+    if (!isVisible() || graphicsScene == NULL || graphicsScene->views().isEmpty())
+        return false;
+
+    QGraphicsView *view = graphicsScene->views().first();
+    QRectF visibleSceneRect = view->mapToScene(view->viewport()->rect()).boundingRect();
+    return visibleSceneRect.intersects(sceneBoundingRect());
 }
 
-void SwitcherPixmapItem::createDamage()
+void SwitcherPixmapItem::updateInViewport()
 {
-    // TODO: check on display status, don't create damage if off
-    if (d->windowId == 0)
+    bool inViewport = isInViewport();
+    if (inViewport == d->inViewport)
         return;
 
-    // Register the pixmap for XDamage events
-    d->xWindowPixmapDamage = X11Wrapper::XDamageCreate(QX11Info::display(), d->windowId, XDamageReportNonEmpty);
+    d->inViewport = inViewport;
+    if (inViewport) {
+        // Take a fresh snapshot of the window and track its damage again
+        startListening();
+        update();
+    } else {
+        // Nothing to show for a window that's scrolled away so stop tracking it altogether
+        stopListening();
+    }
 }
 
-void SwitcherPixmapItem::updateXWindowPixmap()
+QVariant SwitcherPixmapItem::itemChange(GraphicsItemChange change, const QVariant &value)
 {
-#ifdef Q_WS_X11
-    // It is possible that the window is not redirected so check for errors.
-    // XSync() needs to be called so that previous errors go to the original
-    // handler.
-    X11Wrapper::XSync(QX11Info::display(), FALSE);
-    XErrorHandler errh = X11Wrapper::XSetErrorHandler(handleXError);
-    xErrorCode = Success;
-
-    // Get the pixmap ID of the X window
-    Pixmap newWindowPixmap = X11Wrapper::XCompositeNameWindowPixmap(QX11Info::display(), d->windowId);
+    if (change == ItemScenePositionHasChanged) {
+        updateInViewport();
+        updateXWindowIconGeometryIfNecessary();
+    } else if (change == ItemVisibleHasChanged) {
+        updateInViewport();
+    }
 
-    // XCompositeNameWindowPixmap doesn't wait for the server to reply, we'll
-    // need to do it ourselves to catch the possible BadMatch
-    X11Wrapper::XSync(QX11Info::display(), FALSE);
+    return QDeclarativeItem::itemChange(change, value);
+}
 
-    d->xWindowPixmapIsValid = xErrorCode == Success;
-    if (d->xWindowPixmapIsValid) {
-        // Unregister the old pixmap from XDamage events
-        destroyDamage();
+void SwitcherPixmapItem::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QDeclarativeItem::geometryChanged(newGeometry, oldGeometry);
+    updateInViewport();
+    updateXWindowIconGeometryIfNecessary();
+}
 
-        if (d->xWindowPixmap != 0) {
-            // Dereference the old pixmap ID
-            X11Wrapper::XFreePixmap(QX11Info::display(), d->xWindowPixmap);
-        }
+void SwitcherPixmapItem::startListening()
+{
+    if (d->listening || d->windowId == 0)
+        return;
 
-        d->xWindowPixmap = newWindowPixmap;
+    WindowPixmapManager::instance()->addListener(d->windowId, this);
+    d->listening = true;
+}
 
-        // Register the pixmap for XDamage events
-        createDamage();
+void SwitcherPixmapItem::stopListening()
+{
+    if (!d->listening)
+        return;
 
-        d->qWindowPixmap = QPixmap::fromX11Pixmap(d->xWindowPixmap, QPixmap::ExplicitlyShared);
-    } else {
-        // If a BadMatch error occurred the window wasn't redirected yet; deference the invalid pixmap
-        if (newWindowPixmap != 0) {
-            X11Wrapper::XFreePixmap(QX11Info::display(), newWindowPixmap);
-        }
-    }
+    // The thumbnail is rendered from the window pixmap which may go with the listener
+    releaseThumbnail();
+    WindowPixmapManager::instance()->removeListener(d->windowId, this);
+    d->listening = false;
+}
 
-    // Reset the error handler
-    X11Wrapper::XSetErrorHandler(errh);
-#else
-#error "not implemented"
-#endif
+void SwitcherPixmapItem::releaseThumbnail()
+{
+    delete d->texturePixmap;
+    d->texturePixmap = 0;
+    delete d->shmImage;
+    d->shmImage = 0;
+    d->thumbnailIsValid = false;
+    d->thumbnailDamage = QRegion();
+    d->snapshot = QImage();
 }
 
 void SwitcherPixmapItem::setWindowId(int window)
 {
+    // The pixmap and the damage of the previous window are no longer needed
+    stopListening();
     d->windowId = window;
-    d->xWindowPixmapIsValid = false;
-
-    // TODO: should we XFreePixmap here?
+    if (d->inViewport)
+        startListening();
 
     update();
 
     // Each window should always have at least some kind of a value for _NET_WM_ICON_GEOMETRY
+    d->xWindowIconGeometry = QRect();
     updateXWindowIconGeometry();
 }
 
@@ -193,20 +295,120 @@ int SwitcherPixmapItem::windowId() const
     return d->windowId;
 }
 
+bool SwitcherPixmapItem::paintTexturePixmap(QPainter *painter, const QPixmap &thumbnail)
+{
+    // Drawing an X pixmap with the OpenGL engine would read it back from the X server
+    if (thumbnail.isNull() || painter->paintEngine()->type() != QPaintEngine::OpenGL2 || !GLXTexturePixmap::isSupported())
+        return false;
+
+    // The thumbnail pixmap changes when it's resized or evicted from the cache
+    if (d->texturePixmap == 0 || d->texturePixmap->pixmap() != thumbnail.handle()) {
+        delete d->texturePixmap;
+        d->texturePixmap = new GLXTexturePixmap(thumbnail.handle(), thumbnail.depth());
+    }
+    if (!d->texturePixmap->isValid())
+        return false;
+
+    painter->beginNativePainting();
+    d->texturePixmap->draw(QRectF(QPointF(0, 0), thumbnail.size()), painter->opacity());
+    painter->endNativePainting();
+    return true;
+}
+
+bool SwitcherPixmapItem::paintShmImage(QPainter *painter, const QPixmap &thumbnail)
+{
+    // The X11 engine copies the pixmap on the X server; the others would read it through the X protocol
+    if (thumbnail.isNull() || painter->paintEngine()->type() == QPaintEngine::X11 || !XShmImage::isSupported())
+        return false;
+
+    if (d->shmImage == 0 || d->shmImage->size() != thumbnail.size() || d->shmImage->depth() != thumbnail.depth()) {
+        delete d->shmImage;
+        d->shmImage = new XShmImage(thumbnail.size(), thumbnail.depth());
+        d->shmImageKey = 0;
+    }
+    if (!d->shmImage->isValid())
+        return false;
+
+    // The thumbnail is read again only when it has been rendered again
+    if (d->shmImageKey != thumbnail.cacheKey()) {
+        if (!d->shmImage->read(thumbnail.handle()))
+            return false;
+        d->shmImageKey = thumbnail.cacheKey();
+    }
+
+    painter->drawImage(0, 0, d->shmImage->image());
+    return true;
+}
+
+void SwitcherPixmapItem::paintThumbnail(QPainter *painter, const QPixmap &thumbnail)
+{
+#ifdef BENCHMARKS_ON
+    qint64 paintStartTime = benchmarkTime();
+    const char *paintPath = "pixmap";
+#endif
+    if (paintTexturePixmap(painter, thumbnail)) {
+#ifdef BENCHMARKS_ON
+        paintPath = "texture from pixmap";
+#endif
+    } else if (paintShmImage(painter, thumbnail)) {
+#ifdef BENCHMARKS_ON
+        paintPath = "MIT-SHM";
+#endif
+    } else {
+        QT_TRY {
+            painter->drawPixmap(0, 0, thumbnail);
+        } QT_CATCH (const std::bad_alloc &) {
+            // Reading the pixmap back for drawing failed to allocate; skip this paint
+        }
+    }
+#ifdef BENCHMARKS_ON
+    benchmarkPaint(paintPath, benchmarkTime() - paintStartTime);
+#endif
+}
+
 void SwitcherPixmapItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
                                QWidget *widget)
 {
     Q_UNUSED(option);
     Q_UNUSED(widget);
 
-    if (!d->xWindowPixmapIsValid) {
-        updateXWindowPixmap();
+    Qt::HANDLE windowPixmap = d->listening ? WindowPixmapManager::instance()->pixmap(d->windowId) : 0;
+    if (windowPixmap == 0 && d->listening) {
+        // The window may have been redirected since the pixmap was last requested
+        WindowPixmapManager::instance()->requestPixmap(d->windowId);
     }
 
-    QT_TRY {
-        painter->drawPixmap(QRect(0, 0, boundingRect().width(), boundingRect().height()), d->qWindowPixmap);
-    } QT_CATCH (std::bad_alloc e) {
-        // XGetImage failed, the window has been already unmapped
+    if (windowPixmap != 0) {
+        // The thumbnail is only rendered again when the window has been damaged or the size has changed,
+        // and then only the damaged area of it
+        QSize size = boundingRect().size().toSize();
+        QPixmap thumbnail;
+        if (d->thumbnailIsValid && d->thumbnailDamage.isEmpty()) {
+            thumbnail = ThumbnailCache::instance()->thumbnail(d->windowId, size);
+        }
+        if (thumbnail.isNull()) {
+            QRegion damage = d->thumbnailIsValid ? d->thumbnailDamage : QRegion();
+            X11Wrapper::WindowGeometry windowGeometry = WindowPixmapManager::instance()->pixmapGeometry(d->windowId);
+            thumbnail = ThumbnailCache::instance()->updateThumbnail(d->windowId, windowPixmap, windowGeometry, size, damage);
+            d->thumbnailIsValid = !thumbnail.isNull();
+            d->thumbnailDamage = QRegion();
+        }
+        paintThumbnail(painter, thumbnail);
+    } else if (d->windowId != 0) {
+        // An unmapped window is shown as it was last seen, from the thumbnail kept
+        // on the X server if it's still cached or else from the snapshot
+        QPixmap thumbnail = ThumbnailCache::instance()->thumbnail(d->windowId, boundingRect().size().toSize());
+        if (!thumbnail.isNull()) {
+            paintThumbnail(painter, thumbnail);
+        } else {
+            // Decompress the snapshot only once
+            if (d->snapshot.isNull()) {
+                d->snapshot = SnapshotCache::instance()->snapshot(d->windowId);
+            }
+            if (!d->snapshot.isNull()) {
+                painter->drawImage(boundingRect(), d->snapshot);
+            }
+        }
     }
 
     updateXWindowIconGeometryIfNecessary();
@@ -2,8 +2,9 @@
 #define SWITCHERPIXMAPITEM_H
 
 #include <QDeclarativeItem>
+#include "windowpixmaplistener.h"
 
-class SwitcherPixmapItem : public QDeclarativeItem
+class SwitcherPixmapItem : public QDeclarativeItem, public WindowPixmapListener
 {
     Q_OBJECT
 public:
@@ -16,14 +17,31 @@ public:
     void setWindowId(int windowId);
     Q_PROPERTY(int windowId READ windowId WRITE setWindowId);
 
+    //! \reimp
+    virtual void windowPixmapChanged();
+    virtual void windowPixmapDamaged(const QRegion &region);
+    virtual void thumbnailReleased(Qt::HANDLE thumbnail);
+    //! \reimp_end
+
+protected:
+    //! \reimp
+    virtual QVariant itemChange(GraphicsItemChange change, const QVariant &value);
+    virtual void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry);
+    //! \reimp_end
+
 private slots:
     void updateXWindowIconGeometry();
-    void damageEvent(Qt::HANDLE &damage, short &x, short &y, unsigned short &width, unsigned short &height);
 private:
-    void createDamage();
-    void destroyDamage();
-    void updateXWindowPixmap();
+    void startListening();
+    void stopListening();
+    void releaseThumbnail();
+    bool paintTexturePixmap(QPainter *painter, const QPixmap &thumbnail);
+    bool paintShmImage(QPainter *painter, const QPixmap &thumbnail);
+    void paintThumbnail(QPainter *painter, const QPixmap &thumbnail);
+    bool isInViewport() const;
+    void updateInViewport();
     void updateXWindowIconGeometryIfNecessary();
+    QRect iconGeometry() const;
 
     struct Private;
     Private * const d;
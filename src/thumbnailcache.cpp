@@ -0,0 +1,269 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QX11Info>
+#include <qmath.h>
+
+#include "thumbnailcache.h"
+#include "snapshotcache.h"
+#include "windowpixmapmanager.h"
+#include "x11wrapper.h"
+
+//! The default memory budget of all the thumbnails in bytes
+static const int DEFAULT_MEMORY_BUDGET = 8 * 1024 * 1024;
+
+//! The number of bytes used by a thumbnail pixel on the X server
+static const int BYTES_PER_PIXEL = 4;
+
+//! Returns the XRender format of a visual; looked up from the client side visual list, not from the X server
+static XRenderPictFormat *visualFormat(Display *display, VisualID visualId)
+{
+    XVisualInfo visualTemplate;
+    visualTemplate.visualid = visualId;
+    int count = 0;
+    XVisualInfo *visualInfo = X11Wrapper::XGetVisualInfo(display, VisualIDMask, &visualTemplate, &count);
+    if (visualInfo == NULL) {
+        return NULL;
+    }
+
+    XRenderPictFormat *format = count > 0 ? X11Wrapper::XRenderFindVisualFormat(display, visualInfo->visual) : NULL;
+    X11Wrapper::XFree(visualInfo);
+    return format;
+}
+
+struct ThumbnailCache::Thumbnail
+{
+    Thumbnail()
+        : window(0)
+        , windowPixmap(0)
+        , windowPicture(0)
+        , pixmap(0)
+        , picture(0)
+        , lastUsed(0)
+    {}
+
+    Qt::HANDLE window;
+
+    //! The composite pixmap of the window and a picture for rendering from it; 0 when detached
+    Pixmap windowPixmap;
+    Picture windowPicture;
+    QSize windowSize;
+
+    //! The thumbnail pixmap and a picture for rendering to it
+    Pixmap pixmap;
+    Picture picture;
+    QSize size;
+    QPixmap qPixmap;
+
+    //! The value of the usage counter when the thumbnail was last used
+    quint64 lastUsed;
+};
+
+ThumbnailCache *ThumbnailCache::instance()
+{
+    static ThumbnailCache thumbnailCache;
+    return &thumbnailCache;
+}
+
+ThumbnailCache::ThumbnailCache()
+    : usageCounter(0)
+    , memoryBudget_(DEFAULT_MEMORY_BUDGET)
+    , memoryUsage_(0)
+{
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    // The X connection may already be gone so the server resources are left for it to clean up
+    qDeleteAll(thumbnails);
+}
+
+int ThumbnailCache::memoryBudget() const
+{
+    return memoryBudget_;
+}
+
+void ThumbnailCache::setMemoryBudget(int bytes)
+{
+    memoryBudget_ = bytes;
+    evictLeastRecentlyUsed();
+}
+
+int ThumbnailCache::memoryUsage() const
+{
+    return memoryUsage_;
+}
+
+QPixmap ThumbnailCache::thumbnail(Qt::HANDLE window, const QSize &size)
+{
+    Thumbnail *thumbnail = findThumbnail(window, size);
+    if (thumbnail == NULL) {
+        return QPixmap();
+    }
+
+    thumbnail->lastUsed = ++usageCounter;
+    return thumbnail->qPixmap;
+}
+
+QPixmap ThumbnailCache::updateThumbnail(Qt::HANDLE window, Qt::HANDLE windowPixmap, const X11Wrapper::WindowGeometry &windowGeometry,
+                                        const QSize &size, const QRegion &windowRegion)
+{
+    if (window == 0 || windowPixmap == 0 || size.isEmpty() || windowGeometry.size.isEmpty()) {
+        return QPixmap();
+    }
+
+    Display *display = QX11Info::display();
+    Thumbnail *thumbnail = findThumbnail(window, size);
+    if (thumbnail != NULL && thumbnail->windowPixmap != windowPixmap) {
+        // The thumbnail needs to be of the same format as the window, which may have changed along with the pixmap
+        deleteThumbnail(thumbnail);
+        thumbnail = NULL;
+    }
+
+    bool created = false;
+    if (thumbnail == NULL) {
+        XRenderPictFormat *format = visualFormat(display, windowGeometry.visual);
+        if (format == NULL) {
+            return QPixmap();
+        }
+
+        thumbnail = new Thumbnail;
+        thumbnail->window = window;
+        thumbnail->windowPixmap = windowPixmap;
+        thumbnail->windowPicture = X11Wrapper::XRenderCreatePicture(display, windowPixmap, format, 0, NULL);
+        X11Wrapper::XRenderSetPictureFilter(display, thumbnail->windowPicture, FilterBilinear, NULL, 0);
+        thumbnail->windowSize = windowGeometry.size;
+
+        // The transform maps the thumbnail coordinates to the window coordinates
+        XTransform transform = {{
+            { XDoubleToFixed((double)windowGeometry.size.width() / size.width()), 0, 0 },
+            { 0, XDoubleToFixed((double)windowGeometry.size.height() / size.height()), 0 },
+            { 0, 0, XDoubleToFixed(1) }
+        }};
+        X11Wrapper::XRenderSetPictureTransform(display, thumbnail->windowPicture, &transform);
+
+        thumbnail->pixmap = X11Wrapper::XCreatePixmap(display, QX11Info::appRootWindow(), size.width(), size.height(), windowGeometry.depth);
+        thumbnail->picture = X11Wrapper::XRenderCreatePicture(display, thumbnail->pixmap, format, 0, NULL);
+        thumbnail->size = size;
+        memoryUsage_ += size.width() * size.height() * BYTES_PER_PIXEL;
+
+        thumbnails.insert(window, thumbnail);
+        created = true;
+    }
+
+    if (created || windowRegion.isEmpty()) {
+        X11Wrapper::XRenderComposite(display, PictOpSrc, thumbnail->windowPicture, None, thumbnail->picture,
+                                     0, 0, 0, 0, 0, 0, size.width(), size.height());
+    } else {
+        // The source coordinates are in the thumbnail space since the transform is applied to them
+        foreach (const QRect &windowRect, windowRegion.rects()) {
+            QRect rect = mapToThumbnail(window, size, windowRect);
+            if (!rect.isEmpty()) {
+                X11Wrapper::XRenderComposite(display, PictOpSrc, thumbnail->windowPicture, None, thumbnail->picture,
+                                             rect.x(), rect.y(), 0, 0, rect.x(), rect.y(), rect.width(), rect.height());
+            }
+        }
+    }
+
+    // A new QPixmap so that any textures made from the previous contents are not reused
+    thumbnail->qPixmap = QPixmap::fromX11Pixmap(thumbnail->pixmap, QPixmap::ExplicitlyShared);
+    thumbnail->lastUsed = ++usageCounter;
+
+    evictLeastRecentlyUsed(thumbnail);
+
+    return thumbnail->qPixmap;
+}
+
+QRect ThumbnailCache::mapToThumbnail(Qt::HANDLE window, const QSize &size, const QRect &windowRect) const
+{
+    Thumbnail *thumbnail = findThumbnail(window, size);
+    if (thumbnail == NULL || thumbnail->windowSize.isEmpty()) {
+        return QRect();
+    }
+
+    qreal scaleX = (qreal)thumbnail->size.width() / thumbnail->windowSize.width();
+    qreal scaleY = (qreal)thumbnail->size.height() / thumbnail->windowSize.height();
+
+    // The bilinear filter samples the neighbouring pixels too so the rectangle is grown by one
+    QRect rect;
+    rect.setCoords(qFloor(windowRect.left() * scaleX) - 1, qFloor(windowRect.top() * scaleY) - 1,
+                   qCeil((windowRect.right() + 1) * scaleX), qCeil((windowRect.bottom() + 1) * scaleY));
+    return rect.intersected(QRect(QPoint(0, 0), thumbnail->size));
+}
+
+void ThumbnailCache::detachThumbnails(Qt::HANDLE window)
+{
+    foreach (Thumbnail *thumbnail, thumbnails.values(window)) {
+        releaseWindowPicture(thumbnail);
+    }
+}
+
+void ThumbnailCache::removeThumbnails(Qt::HANDLE window)
+{
+    foreach (Thumbnail *thumbnail, thumbnails.values(window)) {
+        deleteThumbnail(thumbnail);
+    }
+}
+
+ThumbnailCache::Thumbnail *ThumbnailCache::findThumbnail(Qt::HANDLE window, const QSize &size) const
+{
+    QMultiHash<Qt::HANDLE, Thumbnail *>::const_iterator thumbnail = thumbnails.constFind(window);
+    while (thumbnail != thumbnails.constEnd() && thumbnail.key() == window) {
+        if (thumbnail.value()->size == size) {
+            return thumbnail.value();
+        }
+        ++thumbnail;
+    }
+    return NULL;
+}
+
+void ThumbnailCache::deleteThumbnail(Thumbnail *thumbnail)
+{
+    Display *display = QX11Info::display();
+    thumbnails.remove(thumbnail->window, thumbnail);
+    releaseWindowPicture(thumbnail);
+
+    // The textures bound to the X pixmap and the QPixmap sharing it need to go first
+    WindowPixmapManager::instance()->thumbnailReleased(thumbnail->window, thumbnail->pixmap);
+    thumbnail->qPixmap = QPixmap();
+    X11Wrapper::XRenderFreePicture(display, thumbnail->picture);
+    X11Wrapper::XFreePixmap(display, thumbnail->pixmap);
+    memoryUsage_ -= thumbnail->size.width() * thumbnail->size.height() * BYTES_PER_PIXEL;
+    delete thumbnail;
+}
+
+void ThumbnailCache::releaseWindowPicture(Thumbnail *thumbnail)
+{
+    if (thumbnail->windowPicture != 0) {
+        X11Wrapper::XRenderFreePicture(QX11Info::display(), thumbnail->windowPicture);
+        thumbnail->windowPicture = 0;
+    }
+    thumbnail->windowPixmap = 0;
+}
+
+void ThumbnailCache::evictLeastRecentlyUsed(Thumbnail *keep)
+{
+    while (memoryUsage_ > memoryBudget_) {
+        Thumbnail *leastRecentlyUsed = NULL;
+        foreach (Thumbnail *thumbnail, thumbnails) {
+            if (thumbnail != keep && (leastRecentlyUsed == NULL || thumbnail->lastUsed < leastRecentlyUsed->lastUsed)) {
+                leastRecentlyUsed = thumbnail;
+            }
+        }
+
+        if (leastRecentlyUsed == NULL) {
+            break;
+        }
+
+        // A detached thumbnail can't be rendered again so it's read back as a snapshot
+        if (leastRecentlyUsed->windowPixmap == 0) {
+            SnapshotCache::instance()->storeSnapshot(leastRecentlyUsed->window, leastRecentlyUsed->qPixmap.toImage());
+        }
+        deleteThumbnail(leastRecentlyUsed);
+    }
+}
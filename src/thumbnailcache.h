@@ -0,0 +1,127 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef THUMBNAILCACHE_H
+#define THUMBNAILCACHE_H
+
+#include <QMultiHash>
+#include <QPixmap>
+#include <QRegion>
+#include <QSize>
+#include "x11wrapper.h"
+
+/*!
+ * A process wide cache of downscaled window thumbnails. The thumbnails are
+ * rendered by the X server from the composite pixmaps of the windows using
+ * XRender and kept as X pixmaps of the requested size, so that painting a
+ * thumbnail is a plain blit. A window has a thumbnail for each size it is
+ * shown in, shared by the items showing it in that size. All the thumbnails
+ * share a single memory
+ * budget; when it is exceeded the least recently used thumbnails are evicted
+ * and rendered again the next time they are needed.
+ *
+ * The thumbnails of an unmapped window are detached from the composite
+ * pixmap and kept as they were. They are only read back into the
+ * SnapshotCache if they are evicted while detached.
+ */
+class ThumbnailCache
+{
+public:
+    //! Returns the ThumbnailCache instance
+    static ThumbnailCache *instance();
+
+    //! Returns the memory budget of all the thumbnails in bytes
+    int memoryBudget() const;
+
+    //! Sets the memory budget of all the thumbnails in bytes
+    void setMemoryBudget(int bytes);
+
+    //! Returns the memory used by the thumbnails in bytes
+    int memoryUsage() const;
+
+    /*!
+     * Returns the cached thumbnail of a window and marks it as the most
+     * recently used one.
+     *
+     * \param window the window
+     * \param size the size of the thumbnail
+     * \return the thumbnail or a null pixmap if there is no thumbnail of the given size
+     */
+    QPixmap thumbnail(Qt::HANDLE window, const QSize &size);
+
+    /*!
+     * Renders the thumbnail of a window from its composite pixmap.
+     * The pixmap returned must not be stored; it is only valid until
+     * the thumbnail is updated, evicted or removed.
+     *
+     * \param window the window
+     * \param windowPixmap the composite pixmap of the window
+     * \param windowGeometry the geometry of the window when the pixmap was named
+     * \param size the size of the thumbnail
+     * \param windowRegion the damaged area of the window to render again. If empty or if the thumbnail doesn't exist yet the whole thumbnail is rendered.
+     * \return the thumbnail or a null pixmap if it couldn't be rendered
+     */
+    QPixmap updateThumbnail(Qt::HANDLE window, Qt::HANDLE windowPixmap, const X11Wrapper::WindowGeometry &windowGeometry,
+                            const QSize &size, const QRegion &windowRegion = QRegion());
+
+    /*!
+     * Maps a rectangle in window coordinates to the thumbnail of the window.
+     * The result covers all the thumbnail pixels affected by the rectangle.
+     *
+     * \param window the window
+     * \param size the size of the thumbnail
+     * \param windowRect the rectangle in window coordinates
+     * \return the rectangle in thumbnail coordinates or a null rectangle if there is no thumbnail of the given size
+     */
+    QRect mapToThumbnail(Qt::HANDLE window, const QSize &size, const QRect &windowRect) const;
+
+    /*!
+     * Detaches the thumbnails of a window from the composite pixmap of the
+     * window. This must be called before the composite pixmap is freed. The
+     * thumbnails keep their contents until they are updated from a new pixmap.
+     *
+     * \param window the window
+     */
+    void detachThumbnails(Qt::HANDLE window);
+
+    /*!
+     * Removes the thumbnails of a window.
+     *
+     * \param window the window
+     */
+    void removeThumbnails(Qt::HANDLE window);
+
+private:
+    ThumbnailCache();
+    ~ThumbnailCache();
+
+    struct Thumbnail;
+
+    //! Returns the thumbnail of \a window of the given size or 0 if there is none
+    Thumbnail *findThumbnail(Qt::HANDLE window, const QSize &size) const;
+
+    //! Releases the server resources of \a thumbnail and deletes it
+    void deleteThumbnail(Thumbnail *thumbnail);
+
+    //! Releases the window picture of \a thumbnail
+    void releaseWindowPicture(Thumbnail *thumbnail);
+
+    //! Evicts the least recently used thumbnails other than \a keep until the budget is met
+    void evictLeastRecentlyUsed(Thumbnail *keep = 0);
+
+    //! The thumbnails by their windows
+    QMultiHash<Qt::HANDLE, Thumbnail *> thumbnails;
+
+    //! The usage counter for ordering the thumbnails by their last use
+    quint64 usageCounter;
+
+    int memoryBudget_;
+    int memoryUsage_;
+};
+
+#endif // THUMBNAILCACHE_H
@@ -19,9 +19,12 @@
 
 #include <QHash>
 #include <QDebug>
+#include <QWidget>
 
 #include "windowinfo.h"
 #include "x11wrapper.h"
+#include "atomcache.h"
+#include "xeventlistener.h"
 #include <QX11Info>
 
 class WindowInfo::WindowData
@@ -35,6 +38,7 @@ public:
             title(),
             types(),
             states(),
+            flags(0),
             pid(0),
             pixmapSerial(0)
     {
@@ -60,47 +64,19 @@ public:
     //! The status atoms of this window
     QList<Atom> states;
 
+    //! The known types and states of this window
+    WindowInfo::WindowFlags flags;
+
     int pid;
 
+    //! The WM_CLASS instance and class names
+    QString windowInstance;
+    QString windowClass;
+
     int pixmapSerial;
 };
 
 
-static bool atomsInitialized;
-
-Atom WindowInfo::TypeAtom;
-Atom WindowInfo::StateAtom;
-Atom WindowInfo::NormalAtom;
-Atom WindowInfo::DesktopAtom;
-Atom WindowInfo::NotificationAtom;
-Atom WindowInfo::DialogAtom;
-Atom WindowInfo::CallAtom;
-Atom WindowInfo::DockAtom;
-Atom WindowInfo::MenuAtom;
-Atom WindowInfo::SkipTaskbarAtom;
-Atom WindowInfo::NameAtom;
-Atom WindowInfo::InputWindowAtom;
-
-void WindowInfo::initializeAtoms()
-{
-    if (!atomsInitialized) {
-        Display *dpy = QX11Info::display();
-        TypeAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
-        StateAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_STATE", False);
-        NormalAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_NORMAL", False);
-        DesktopAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DESKTOP", False);
-        NotificationAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_NOTIFICATION", False);
-        DialogAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
-        CallAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_CALL", False);
-        DockAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DOCK", False);
-        MenuAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_MENU", False);
-        SkipTaskbarAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_STATE_SKIP_TASKBAR", False);
-        NameAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_NAME", False);
-        InputWindowAtom = X11Wrapper::XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_INPUT", False);
-        atomsInitialized = true;
-    }
-}
-
 //! Storage for the WindowInfo data objects. A central storage enables constructing
 //! new WindowInfo objects with shared data.
 static QHash<Window, WindowInfo * > windowDatas;
@@ -114,15 +90,58 @@ WindowInfo *WindowInfo::windowFor(Window wid)
     }
 }
 
+/*!
+ * Keeps the cached properties of the WindowInfo objects up to date by
+ * re-fetching a property whenever a PropertyNotify arrives for it.
+ */
+class WindowPropertyListener : public XEventListener
+{
+public:
+    virtual bool handleXEvent(const XEvent &event)
+    {
+        if (event.type == PropertyNotify) {
+            if (WindowInfo *wi = windowDatas.value(event.xproperty.window)) {
+                return wi->updateProperty(event.xproperty.atom);
+            }
+        }
+        return false;
+    }
+};
+
+WindowInfo *WindowInfo::existingWindowFor(Window wid)
+{
+    return windowDatas.value(wid);
+}
+
+WindowInfo *WindowInfo::windowFor(const X11Wrapper::WindowProperties &properties)
+{
+    if (WindowInfo *wi = windowDatas.value(properties.window)) {
+        wi->setProperties(properties);
+        return wi;
+    } else {
+        return new WindowInfo(properties);
+    }
+}
+
 WindowInfo::WindowInfo(Window window)
     : d(new WindowData(window))
 {
     qDebug() << Q_FUNC_INFO << "Created WindowInfo for " << window;
+    selectEvents();
     updateWindowTitle();
     updateWindowProperties();
     windowDatas[window] = this;
 }
 
+WindowInfo::WindowInfo(const X11Wrapper::WindowProperties &properties)
+    : d(new WindowData(properties.window))
+{
+    qDebug() << Q_FUNC_INFO << "Created WindowInfo for " << properties.window;
+    selectEvents();
+    setProperties(properties);
+    windowDatas[properties.window] = this;
+}
+
 WindowInfo::~WindowInfo()
 {
     qDebug() << Q_FUNC_INFO << "Destroyed windwo for " << d->window;
@@ -144,16 +163,67 @@ Window WindowInfo::transientFor() const
     return d->transientFor;
 }
 
-QList<Atom> WindowInfo::types() const
+const QList<Atom> &WindowInfo::types() const
 {
     return d->types;
 }
 
-QList<Atom> WindowInfo::states() const
+const QList<Atom> &WindowInfo::states() const
 {
     return d->states;
 }
 
+WindowInfo::WindowFlags WindowInfo::flags() const
+{
+    return d->flags;
+}
+
+bool WindowInfo::isFullscreenApplicationWindow() const
+{
+    return !(d->flags & (NotificationType | DialogType | MenuType));
+}
+
+bool WindowInfo::belongsInSwitcher() const
+{
+    // plain Xlib windows do not have a type
+    return (d->types.isEmpty() || (d->flags & NormalType)) &&
+           !(d->flags & (DesktopType | NotificationType | DockType | SkipTaskbarState));
+}
+
+void WindowInfo::updateFlags()
+{
+    static const struct {
+        AtomCache::AtomId atom;
+        WindowFlag flag;
+    } typeFlags[] = {
+        { AtomCache::NetWmWindowTypeNormal, NormalType },
+        { AtomCache::NetWmWindowTypeDialog, DialogType },
+        { AtomCache::NetWmWindowTypeMenu, MenuType },
+        { AtomCache::NetWmWindowTypeNotification, NotificationType },
+        { AtomCache::NetWmWindowTypeDock, DockType },
+        { AtomCache::NetWmWindowTypeDesktop, DesktopType },
+        { AtomCache::NetWmWindowTypeInput, InputType },
+        { AtomCache::NetWmWindowTypeCall, CallType }
+    };
+
+    WindowFlags flags;
+    foreach (Atom type, d->types) {
+        for (unsigned int i = 0; i < sizeof(typeFlags) / sizeof(typeFlags[0]); i++) {
+            if (type == AtomCache::atom(typeFlags[i].atom)) {
+                flags |= typeFlags[i].flag;
+                break;
+            }
+        }
+    }
+    if (d->states.contains(AtomCache::atom(AtomCache::NetWmStateSkipTaskbar))) {
+        flags |= SkipTaskbarState;
+    }
+    if (d->states.contains(AtomCache::atom(AtomCache::NetWmStateHidden))) {
+        flags |= HiddenState;
+    }
+    d->flags = flags;
+}
+
 bool operator==(const WindowInfo &wi1, const WindowInfo &wi2)
 {
     return wi1.window() == wi2.window();
@@ -164,7 +234,7 @@ bool WindowInfo::updateWindowTitle()
     Display *dpy = QX11Info::display();
     XTextProperty textProperty;
     bool updated = false;
-    int result = X11Wrapper::XGetTextProperty(dpy, d->window, &textProperty, WindowInfo::NameAtom);
+    int result = X11Wrapper::XGetTextProperty(dpy, d->window, &textProperty, AtomCache::atom(AtomCache::NetWmName));
     if (result == 0) {
         result = X11Wrapper::XGetWMName(dpy, d->window, &textProperty);
     }
@@ -179,14 +249,87 @@ bool WindowInfo::updateWindowTitle()
 
 void WindowInfo::updateWindowProperties()
 {
-    d->types = getWindowProperties(d->window, WindowInfo::TypeAtom);
-    d->states = getWindowProperties(d->window, WindowInfo::StateAtom);
+    d->types = getWindowProperties(d->window, AtomCache::atom(AtomCache::NetWmWindowType));
+    d->states = getWindowProperties(d->window, AtomCache::atom(AtomCache::NetWmState));
+    updateFlags();
 
     if (!X11Wrapper::XGetTransientForHint(QX11Info::display(), d->window, &d->transientFor) || d->transientFor == d->window) {
         d->transientFor = 0;
     }
 }
 
+void WindowInfo::setProperties(const X11Wrapper::WindowProperties &properties)
+{
+    d->title = properties.title;
+    d->types = properties.types;
+    d->states = properties.states;
+    updateFlags();
+    d->transientFor = properties.transientFor != d->window ? properties.transientFor : 0;
+    d->pid = properties.pid;
+    d->windowInstance = properties.windowInstance;
+    d->windowClass = properties.windowClass;
+}
+
+void WindowInfo::selectEvents()
+{
+    static WindowPropertyListener propertyListener;
+
+    if (QWidget::find(d->window) == NULL) {
+        // The structure events are handled by WindowPixmapManager
+        X11Wrapper::XSelectInput(QX11Info::display(), d->window, PropertyChangeMask | StructureNotifyMask);
+    }
+}
+
+bool WindowInfo::updateProperty(Atom property)
+{
+    if (property == AtomCache::atom(AtomCache::NetWmName) || property == XA_WM_NAME) {
+        QString oldTitle = d->title;
+        if (updateWindowTitle() && d->title != oldTitle) {
+            emit titleChanged();
+        }
+    } else if (property == AtomCache::atom(AtomCache::NetWmWindowType)) {
+        QList<Atom> types = getWindowProperties(d->window, AtomCache::atom(AtomCache::NetWmWindowType));
+        if (types != d->types) {
+            d->types = types;
+            updateFlags();
+            emit typesChanged();
+        }
+    } else if (property == AtomCache::atom(AtomCache::NetWmState)) {
+        QList<Atom> states = getWindowProperties(d->window, AtomCache::atom(AtomCache::NetWmState));
+        if (states != d->states) {
+            d->states = states;
+            updateFlags();
+            emit statesChanged();
+        }
+    } else if (property == XA_WM_TRANSIENT_FOR) {
+        Window transientFor = 0;
+        if (!X11Wrapper::XGetTransientForHint(QX11Info::display(), d->window, &transientFor) || transientFor == d->window) {
+            transientFor = 0;
+        }
+        if (transientFor != d->transientFor) {
+            d->transientFor = transientFor;
+            emit transientForChanged();
+        }
+    } else if (property == XA_WM_CLASS) {
+        X11Wrapper::WindowProperties properties = X11Wrapper::scanWindows(QX11Info::display(), QList<Window>() << d->window, X11Wrapper::ScanClass).value(0);
+        if (properties.windowInstance != d->windowInstance || properties.windowClass != d->windowClass) {
+            d->windowInstance = properties.windowInstance;
+            d->windowClass = properties.windowClass;
+            emit classChanged();
+        }
+    } else if (property == AtomCache::atom(AtomCache::NetWmPid)) {
+        X11Wrapper::WindowProperties properties = X11Wrapper::scanWindows(QX11Info::display(), QList<Window>() << d->window, X11Wrapper::ScanPid).value(0);
+        if (properties.pid != d->pid) {
+            d->pid = properties.pid;
+            emit pidChanged();
+        }
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
 int WindowInfo::pid() const
 {
     return d->pid;
@@ -197,6 +340,16 @@ void WindowInfo::setPid(int pid)
     d->pid = pid;
 }
 
+const QString &WindowInfo::windowClass() const
+{
+    return d->windowClass;
+}
+
+const QString &WindowInfo::windowInstance() const
+{
+    return d->windowInstance;
+}
+
 QList<Atom> WindowInfo::getWindowProperties(Window winId, Atom propertyAtom, long maxCount)
 {
     QList<Atom> properties;
@@ -26,6 +26,7 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <QExplicitlySharedDataPointer>
+#include "x11wrapper.h"
 
 /*!
  * WindowInfo is a helper class for storing information about an open window.
@@ -34,31 +35,48 @@ class WindowInfo : public QObject
 {
     Q_OBJECT
 public:
-    // X11 atoms
-    static Atom TypeAtom;
-    static Atom StateAtom;
-    static Atom NormalAtom;
-    static Atom DesktopAtom;
-    static Atom NotificationAtom;
-    static Atom DialogAtom;
-    static Atom CallAtom;
-    static Atom DockAtom;
-    static Atom MenuAtom;
-    static Atom SkipTaskbarAtom;
-    static Atom InputWindowAtom;
-    static Atom NameAtom;
+    /*!
+     * The known window types and states of a window. The flags are computed
+     * whenever the types or states change so that classifying a window
+     * doesn't need to go through the atom lists.
+     */
+    enum WindowFlag {
+        NormalType = 0x0001,
+        DialogType = 0x0002,
+        MenuType = 0x0004,
+        NotificationType = 0x0008,
+        DockType = 0x0010,
+        DesktopType = 0x0020,
+        InputType = 0x0040,
+        CallType = 0x0080,
+        SkipTaskbarState = 0x0100,
+        HiddenState = 0x0200
+    };
+    Q_DECLARE_FLAGS(WindowFlags, WindowFlag)
 
     static WindowInfo *windowFor(Window wid);
 
     /*!
-     * Destroys a WindowInfo object.
+     * Returns the WindowInfo for the window described by \a properties.
+     * The title, types, states, transient-for window and PID are taken from
+     * \a properties so no requests are made to the X server.
+     *
+     * \param properties the result of a window scan with X11Wrapper::ScanAll
      */
-    ~WindowInfo();
+    static WindowInfo *windowFor(const X11Wrapper::WindowProperties &properties);
 
     /*!
-     * Initializes the X11 atoms
+     * Returns the WindowInfo for the window if one has already been created.
+     *
+     * \param wid the window ID
+     * \return the WindowInfo or 0 if there is none for the window
      */
-    static void initializeAtoms();
+    static WindowInfo *existingWindowFor(Window wid);
+
+    /*!
+     * Destroys a WindowInfo object.
+     */
+    ~WindowInfo();
 
     /*!
      * Gets the title of the window.
@@ -71,13 +89,32 @@ public:
      * Gets the types for this window \s WindowType
      * \return the types
      */
-    QList<Atom> types() const;
+    const QList<Atom> &types() const;
 
     /*!
      * Gets the states for this window \s WindowType
      * \return the states
      */
-    QList<Atom> states() const;
+    const QList<Atom> &states() const;
+
+    /*!
+     * Gets the known types and states of this window.
+     * \return the window flags
+     */
+    WindowFlags flags() const;
+
+    /*!
+     * Returns whether the window is a full screen application window, i.e.
+     * not a notification, a dialog or a menu.
+     */
+    bool isFullscreenApplicationWindow() const;
+
+    /*!
+     * Returns whether the window should be shown in the switcher: it is a
+     * normal or an untyped window that isn't a desktop, a dock or a
+     * notification and doesn't ask to be skipped from the task bar.
+     */
+    bool belongsInSwitcher() const;
 
     /*!
      * Gets the window ID.
@@ -112,6 +149,14 @@ public:
      */
     void setPid(int pid);
 
+    /*! Retrieve the class name part of the WM_CLASS of this window.
+     */
+    const QString &windowClass() const;
+
+    /*! Retrieve the instance name part of the WM_CLASS of this window.
+     */
+    const QString &windowInstance() const;
+
     Q_PROPERTY(int pixmapSerial READ pixmapSerial WRITE setPixmapSerial NOTIFY pixmapSerialChanged);
     int pixmapSerial() const;
     void setPixmapSerial(int pixmapSerial);
@@ -119,8 +164,50 @@ public:
 signals:
     void pixmapSerialChanged();
 
+    //! Emitted when the title of the window has changed
+    void titleChanged();
+
+    //! Emitted when the _NET_WM_WINDOW_TYPE of the window has changed
+    void typesChanged();
+
+    //! Emitted when the _NET_WM_STATE of the window has changed
+    void statesChanged();
+
+    //! Emitted when the WM_TRANSIENT_FOR hint of the window has changed
+    void transientForChanged();
+
+    //! Emitted when the WM_CLASS of the window has changed
+    void classChanged();
+
+    //! Emitted when the _NET_WM_PID of the window has changed
+    void pidChanged();
+
 private:
     WindowInfo(Window window);
+    WindowInfo(const X11Wrapper::WindowProperties &properties);
+
+    //! Copies the scanned properties to the window data
+    void setProperties(const X11Wrapper::WindowProperties &properties);
+
+    //! Computes the window flags from the types and states
+    void updateFlags();
+
+    /*!
+     * Selects property change and structure events for the window so that
+     * the cached properties and the composite pixmap of the window can be
+     * kept up to date. Home's own windows are skipped since selecting input
+     * for them would override the event mask set by Qt.
+     */
+    void selectEvents();
+
+    /*!
+     * Re-fetches the cached property \a property after it has changed.
+     *
+     * \return \c true if the property is one of the cached ones
+     */
+    bool updateProperty(Atom property);
+
+    friend class WindowPropertyListener;
 
     /*!
      * Gets the atoms and places them into the list
@@ -133,6 +220,8 @@ private:
 
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(WindowInfo::WindowFlags)
+
 //! Comparison operator for WindowInfo objects
 bool operator==(const WindowInfo &, const WindowInfo &);
 
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef WINDOWPIXMAPLISTENER_H_
+#define WINDOWPIXMAPLISTENER_H_
+
+#include <QRegion>
+
+/*!
+ * An interface for users of the composite pixmap of a window. Listeners
+ * are registered with WindowPixmapManager::addListener(), which keeps the
+ * pixmap and its damage tracking alive as long as there are listeners.
+ */
+class WindowPixmapListener
+{
+public:
+    /*!
+     * Destructor.
+     */
+    virtual ~WindowPixmapListener() {}
+
+    /*!
+     * Called when the composite pixmap of the window has been named or
+     * released, for example because the window was unmapped or resized.
+     * Anything rendered from the previous pixmap should be dropped.
+     */
+    virtual void windowPixmapChanged() = 0;
+
+    /*!
+     * Called at most once per frame with the area of the window damaged
+     * since the previous call.
+     * \param region the damaged area in window coordinates
+     */
+    virtual void windowPixmapDamaged(const QRegion &region) = 0;
+
+    /*!
+     * Called before a thumbnail of the window is freed by the
+     * ThumbnailCache, for example when it is evicted. Anything bound to
+     * the thumbnail pixmap should be released.
+     * \param thumbnail the X pixmap of the thumbnail
+     */
+    virtual void thumbnailReleased(Qt::HANDLE thumbnail) = 0;
+};
+
+#endif /* WINDOWPIXMAPLISTENER_H_ */
@@ -0,0 +1,406 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QApplication>
+#include <QList>
+#include <QVarLengthArray>
+#include <QX11Info>
+
+#include "windowpixmapmanager.h"
+#include "windowpixmaplistener.h"
+#include "homeapplication.h"
+#include "snapshotcache.h"
+#include "thumbnailcache.h"
+#include "x11wrapper.h"
+#include "xdamagelistener.h"
+#include "xerrortrap.h"
+#include "xeventlistener.h"
+
+//! The interval for checking whether the pending pixmaps have been named, i.e. the length of a frame
+static const int PIXMAP_REQUEST_INTERVAL = 16;
+
+/*!
+ * The composite pixmap and the Damage object of a single window.
+ */
+class WindowPixmap : public XDamageListener
+{
+public:
+    WindowPixmap(Window window)
+        : window(window)
+        , pixmap(0)
+        , requestedPixmap(0)
+        , request(0)
+        , damage(0)
+        , repairRegion(0)
+        , destroyed(false)
+    {}
+
+    //! Sends a request for naming the pixmap unless it has been named or requested already
+    void requestPixmap();
+
+    //! Adopts the requested pixmap if the request has been processed. Returns false while it is pending.
+    bool checkPixmapRequest();
+
+    //! Releases the pixmap, the Damage object and any pending request. The listeners are notified if there was a pixmap.
+    void release();
+
+    //! \reimp
+    virtual void handleXDamageNotify(const XDamageNotifyEvent &event);
+    virtual void processXDamage();
+    //! \reimp_end
+
+    Window window;
+    Pixmap pixmap;
+
+    //! The pixmap ID requested to be named and the serial number of the request
+    Pixmap requestedPixmap;
+    unsigned long request;
+
+    //! The request for the geometry of the window, sent just before the pixmap was requested
+    X11Wrapper::WindowGeometryRequest geometryRequest;
+
+    Damage damage;
+
+    //! The region used for subtracting the processed area from the damage
+    XserverRegion repairRegion;
+
+    //! The area of the window damaged since the damage was last processed
+    QRegion damageRegion;
+
+    //! The geometry of the window when the pixmap was named
+    X11Wrapper::WindowGeometry pixmapGeometry;
+
+    //! The size of the window as last configured while the pixmap request was pending
+    QSize pendingSize;
+
+    //! Whether the window has been destroyed
+    bool destroyed;
+
+    QList<WindowPixmapListener *> listeners;
+};
+
+void WindowPixmap::requestPixmap()
+{
+    if (pixmap != 0 || requestedPixmap != 0 || destroyed)
+        return;
+
+    // The geometry of the window is asked first so that it is that of the named pixmap
+    pendingSize = QSize();
+    geometryRequest = X11Wrapper::requestWindowGeometry(QX11Info::display(), window);
+
+    // It is possible that the window is not redirected so the errors are trapped.
+    // The request goes out with the others sent during this frame.
+    request = XErrorTrap::instance()->trapNextRequest();
+    requestedPixmap = X11Wrapper::XCompositeNameWindowPixmap(QX11Info::display(), window);
+}
+
+bool WindowPixmap::checkPixmapRequest()
+{
+    if (requestedPixmap == 0)
+        return true;
+
+    XErrorTrap *xErrorTrap = XErrorTrap::instance();
+    if (!xErrorTrap->isProcessed(request))
+        return false;
+
+    // The replies to the geometry requests sent before have already arrived
+    Display *display = QX11Info::display();
+    X11Wrapper::WindowGeometry geometry = X11Wrapper::windowGeometryReply(display, geometryRequest);
+
+    Pixmap newPixmap = requestedPixmap;
+    requestedPixmap = 0;
+
+    // If a BadMatch error occurred the window wasn't redirected yet and no pixmap was created
+    if (xErrorTrap->takeError(request) != Success)
+        return true;
+
+    pixmap = newPixmap;
+    pixmapGeometry = geometry;
+
+    // Register the window for XDamage events
+    damage = X11Wrapper::XDamageCreate(display, window, XDamageReportDeltaRectangles);
+    repairRegion = X11Wrapper::XFixesCreateRegion(display, NULL, 0);
+    HomeApplication *app = dynamic_cast<HomeApplication *>(qApp);
+    if (app) {
+        app->addXDamageListener(damage, this);
+    }
+
+    return true;
+}
+
+void WindowPixmap::release()
+{
+    Display *display = QX11Info::display();
+    if (damage != 0) {
+        HomeApplication *app = dynamic_cast<HomeApplication *>(qApp);
+        if (app) {
+            app->removeXDamageListener(damage);
+        }
+
+        // The X server destroys the Damage object along with the window
+        if (!destroyed) {
+            X11Wrapper::XDamageDestroy(display, damage);
+        }
+        X11Wrapper::XFixesDestroyRegion(display, repairRegion);
+        damage = 0;
+        repairRegion = 0;
+        damageRegion = QRegion();
+    }
+
+    if (requestedPixmap != 0) {
+        // The outcome of the request is not known yet so free the pixmap ID ignoring any errors
+        XErrorTrap *xErrorTrap = XErrorTrap::instance();
+        xErrorTrap->ignore(request);
+        unsigned long serial = xErrorTrap->trapNextRequest();
+        X11Wrapper::XFreePixmap(display, requestedPixmap);
+        xErrorTrap->ignore(serial);
+        X11Wrapper::discardReply(display, geometryRequest);
+        requestedPixmap = 0;
+    }
+
+    if (pixmap != 0) {
+        Pixmap oldPixmap = pixmap;
+        pixmap = 0;
+
+        // The listeners release the textures and images bound to the thumbnails
+        // and the thumbnails stop rendering from the pixmap before it's freed.
+        // They keep their contents so that an unmapped window can be previewed.
+        foreach (WindowPixmapListener *listener, listeners) {
+            listener->windowPixmapChanged();
+        }
+        ThumbnailCache::instance()->detachThumbnails(window);
+        X11Wrapper::XFreePixmap(display, oldPixmap);
+    }
+}
+
+void WindowPixmap::handleXDamageNotify(const XDamageNotifyEvent &event)
+{
+    // Each event reports an area that wasn't damaged yet; they are processed once per frame
+    damageRegion += QRect(event.area.x, event.area.y, event.area.width, event.area.height);
+}
+
+void WindowPixmap::processXDamage()
+{
+    if (damageRegion.isEmpty())
+        return;
+
+    // Subtract only the processed area so that it gets reported again when damaged again
+    QVector<QRect> rects = damageRegion.rects();
+    QVarLengthArray<XRectangle, 16> xRects(rects.count());
+    for (int i = 0; i < rects.count(); i++) {
+        xRects[i].x = rects.at(i).x();
+        xRects[i].y = rects.at(i).y();
+        xRects[i].width = rects.at(i).width();
+        xRects[i].height = rects.at(i).height();
+    }
+    X11Wrapper::XFixesSetRegion(QX11Info::display(), repairRegion, xRects.data(), xRects.count());
+    X11Wrapper::XDamageSubtract(QX11Info::display(), damage, repairRegion, None);
+
+    QRegion region = damageRegion;
+    damageRegion = QRegion();
+    foreach (WindowPixmapListener *listener, listeners) {
+        listener->windowPixmapDamaged(region);
+    }
+}
+
+/*!
+ * Releases and renames the pixmaps as the windows get unmapped, destroyed,
+ * mapped or resized. The events are selected by WindowInfo.
+ */
+class WindowStructureListener : public XEventListener
+{
+public:
+    virtual bool handleXEvent(const XEvent &event)
+    {
+        WindowPixmapManager *manager = WindowPixmapManager::instance();
+        switch (event.type) {
+        case MapNotify:
+            manager->windowMapped(event.xmap.window);
+            break;
+        case UnmapNotify:
+            manager->windowUnmapped(event.xunmap.window, false);
+            break;
+        case DestroyNotify:
+            manager->windowUnmapped(event.xdestroywindow.window, true);
+            break;
+        case ConfigureNotify:
+            manager->windowConfigured(event.xconfigure.window, QSize(event.xconfigure.width, event.xconfigure.height));
+            break;
+        default:
+            break;
+        }
+
+        // Others may be interested in the same events
+        return false;
+    }
+};
+
+WindowPixmapManager *WindowPixmapManager::instance()
+{
+    static WindowPixmapManager windowPixmapManager;
+    return &windowPixmapManager;
+}
+
+WindowPixmapManager::WindowPixmapManager()
+{
+    static WindowStructureListener structureListener;
+
+    pixmapRequestTimer.setSingleShot(true);
+    pixmapRequestTimer.setInterval(PIXMAP_REQUEST_INTERVAL);
+    connect(&pixmapRequestTimer, SIGNAL(timeout()), this, SLOT(checkPixmapRequests()));
+}
+
+WindowPixmapManager::~WindowPixmapManager()
+{
+    // The X connection may already be gone so the server resources are left for it to clean up
+    qDeleteAll(windowPixmaps);
+}
+
+void WindowPixmapManager::addListener(Qt::HANDLE window, WindowPixmapListener *listener)
+{
+    if (window == 0 || listener == NULL)
+        return;
+
+    WindowPixmap *windowPixmap = windowPixmaps.value(window);
+    if (windowPixmap == NULL) {
+        windowPixmap = new WindowPixmap(window);
+        windowPixmaps.insert(window, windowPixmap);
+    }
+
+    if (!windowPixmap->listeners.contains(listener)) {
+        windowPixmap->listeners.append(listener);
+    }
+    requestPixmap(window);
+}
+
+void WindowPixmapManager::removeListener(Qt::HANDLE window, WindowPixmapListener *listener)
+{
+    WindowPixmap *windowPixmap = windowPixmaps.value(window);
+    if (windowPixmap == NULL)
+        return;
+
+    windowPixmap->listeners.removeOne(listener);
+    if (windowPixmap->listeners.isEmpty()) {
+        // The thumbnails of an unmapped window are the only preview of it so they're kept
+        bool mapped = windowPixmap->pixmap != 0;
+        windowPixmaps.remove(window);
+        windowPixmap->release();
+        delete windowPixmap;
+        if (mapped) {
+            ThumbnailCache::instance()->removeThumbnails(window);
+        }
+    }
+}
+
+Qt::HANDLE WindowPixmapManager::pixmap(Qt::HANDLE window) const
+{
+    WindowPixmap *windowPixmap = windowPixmaps.value(window);
+    return windowPixmap != NULL ? windowPixmap->pixmap : 0;
+}
+
+X11Wrapper::WindowGeometry WindowPixmapManager::pixmapGeometry(Qt::HANDLE window) const
+{
+    WindowPixmap *windowPixmap = windowPixmaps.value(window);
+    return windowPixmap != NULL && windowPixmap->pixmap != 0 ? windowPixmap->pixmapGeometry : X11Wrapper::WindowGeometry();
+}
+
+void WindowPixmapManager::requestPixmap(Qt::HANDLE window)
+{
+    WindowPixmap *windowPixmap = windowPixmaps.value(window);
+    if (windowPixmap == NULL)
+        return;
+
+    windowPixmap->requestPixmap();
+    if (windowPixmap->requestedPixmap != 0 && !pixmapRequestTimer.isActive()) {
+        pixmapRequestTimer.start();
+    }
+}
+
+void WindowPixmapManager::thumbnailReleased(Qt::HANDLE window, Qt::HANDLE thumbnail)
+{
+    WindowPixmap *windowPixmap = windowPixmaps.value(window);
+    if (windowPixmap == NULL)
+        return;
+
+    foreach (WindowPixmapListener *listener, windowPixmap->listeners) {
+        listener->thumbnailReleased(thumbnail);
+    }
+}
+
+void WindowPixmapManager::checkPixmapRequests()
+{
+    bool pending = false;
+    foreach (WindowPixmap *windowPixmap, windowPixmaps) {
+        if (windowPixmap->requestedPixmap == 0)
+            continue;
+
+        if (!windowPixmap->checkPixmapRequest()) {
+            pending = true;
+        } else if (windowPixmap->pixmap != 0 && windowPixmap->pendingSize.isValid() &&
+                   windowPixmap->pendingSize != windowPixmap->pixmapGeometry.size) {
+            // The window was resized after the pixmap was named
+            releasePixmap(windowPixmap);
+            requestPixmap(windowPixmap->window);
+            pending = true;
+        } else if (windowPixmap->pixmap != 0) {
+            // The window can be shown as it is again
+            SnapshotCache::instance()->removeSnapshot(windowPixmap->window);
+            foreach (WindowPixmapListener *listener, windowPixmap->listeners) {
+                listener->windowPixmapChanged();
+            }
+        }
+    }
+
+    if (pending) {
+        pixmapRequestTimer.start();
+    }
+}
+
+void WindowPixmapManager::windowMapped(Qt::HANDLE window)
+{
+    requestPixmap(window);
+}
+
+void WindowPixmapManager::windowUnmapped(Qt::HANDLE window, bool destroyed)
+{
+    // The thumbnail of an unmapped window is kept for previewing it
+    WindowPixmap *windowPixmap = windowPixmaps.value(window);
+    if (windowPixmap != NULL) {
+        releasePixmap(windowPixmap, destroyed);
+    }
+
+    if (destroyed) {
+        ThumbnailCache::instance()->removeThumbnails(window);
+        SnapshotCache::instance()->removeSnapshot(window);
+    }
+}
+
+void WindowPixmapManager::windowConfigured(Qt::HANDLE window, const QSize &size)
+{
+    WindowPixmap *windowPixmap = windowPixmaps.value(window);
+    if (windowPixmap == NULL)
+        return;
+
+    if (windowPixmap->requestedPixmap != 0) {
+        // Whether the configuration came before or after the naming is only known once the request has been processed
+        windowPixmap->pendingSize = size;
+    } else if (windowPixmap->pixmap != 0 && windowPixmap->pixmapGeometry.size != size) {
+        // A resized window gets a new pixmap; moves and restacking keep the old one
+        releasePixmap(windowPixmap);
+        requestPixmap(window);
+    }
+}
+
+void WindowPixmapManager::releasePixmap(WindowPixmap *windowPixmap, bool windowDestroyed)
+{
+    if (windowDestroyed) {
+        windowPixmap->destroyed = true;
+    }
+
+    windowPixmap->release();
+}
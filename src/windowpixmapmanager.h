@@ -0,0 +1,124 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef WINDOWPIXMAPMANAGER_H
+#define WINDOWPIXMAPMANAGER_H
+
+#include <QObject>
+#include <QHash>
+#include <QSize>
+#include <QTimer>
+#include "x11wrapper.h"
+
+class WindowPixmap;
+class WindowPixmapListener;
+
+/*!
+ * A process wide manager of the composite pixmaps of windows. There is one
+ * named pixmap and one Damage object per window regardless of how many
+ * items show the window; they are reference counted by the listeners of
+ * the window and released when the last listener is removed.
+ *
+ * The pixmap is released as soon as the window is unmapped or destroyed,
+ * and named again when the window is mapped again or resized. The last
+ * thumbnail of an unmapped window is kept in the ThumbnailCache, or in the
+ * SnapshotCache once evicted from there, until the window is mapped again
+ * or destroyed.
+ */
+class WindowPixmapManager : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Returns the WindowPixmapManager instance
+    static WindowPixmapManager *instance();
+
+    /*!
+     * Adds a listener for the composite pixmap of a window. The pixmap is
+     * requested when the first listener is added.
+     *
+     * \param window the window
+     * \param listener the listener
+     */
+    void addListener(Qt::HANDLE window, WindowPixmapListener *listener);
+
+    /*!
+     * Removes a listener of the composite pixmap of a window. The pixmap
+     * and the Damage object are released when the last listener is removed.
+     *
+     * \param window the window
+     * \param listener the listener
+     */
+    void removeListener(Qt::HANDLE window, WindowPixmapListener *listener);
+
+    /*!
+     * Returns the composite pixmap of a window.
+     *
+     * \param window the window
+     * \return the pixmap or 0 if it hasn't been named (yet)
+     */
+    Qt::HANDLE pixmap(Qt::HANDLE window) const;
+
+    /*!
+     * Returns the size, depth and visual the window had when its composite
+     * pixmap was named. They are fetched along with naming the pixmap so
+     * asking for them makes no requests to the X server.
+     *
+     * \param window the window
+     * \return the geometry or an empty geometry if the pixmap hasn't been named (yet)
+     */
+    X11Wrapper::WindowGeometry pixmapGeometry(Qt::HANDLE window) const;
+
+    /*!
+     * Requests the composite pixmap of a window to be named if it isn't
+     * already. The request doesn't block; the listeners are notified a frame
+     * later if it succeeded. It fails if the window isn't redirected yet.
+     *
+     * \param window the window
+     */
+    void requestPixmap(Qt::HANDLE window);
+
+    /*!
+     * Tells the listeners of a window that a thumbnail of the window is
+     * about to be freed. Called by the ThumbnailCache.
+     *
+     * \param window the window
+     * \param thumbnail the X pixmap of the thumbnail
+     */
+    void thumbnailReleased(Qt::HANDLE window, Qt::HANDLE thumbnail);
+
+private slots:
+    //! Adopts the pixmaps that have been named and keeps checking those that haven't
+    void checkPixmapRequests();
+
+private:
+    WindowPixmapManager();
+    ~WindowPixmapManager();
+
+    //! Names the pixmap of \a window again once it has been mapped
+    void windowMapped(Qt::HANDLE window);
+
+    //! Releases the pixmap of \a window when it can no longer be used
+    void windowUnmapped(Qt::HANDLE window, bool destroyed);
+
+    //! Names the pixmap of \a window again if its size changed
+    void windowConfigured(Qt::HANDLE window, const QSize &size);
+
+    //! Releases the pixmap of \a windowPixmap and notifies its listeners
+    void releasePixmap(WindowPixmap *windowPixmap, bool windowDestroyed = false);
+
+    //! The pixmaps by their windows
+    QHash<Qt::HANDLE, WindowPixmap *> windowPixmaps;
+
+    //! Timer for checking the pending pixmap requests once per frame
+    QTimer pixmapRequestTimer;
+
+    friend class WindowStructureListener;
+};
+
+#endif // WINDOWPIXMAPMANAGER_H
@@ -18,13 +18,89 @@
 ****************************************************************************/
 
 #include "x11wrapper.h"
+#include "atomcache.h"
 #include <QX11Info>
+#include <QStringList>
+#include <QVector>
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <stdlib.h>
+
+//! The cookies of the requests sent for a single window
+struct ScanCookies
+{
+    xcb_get_window_attributes_cookie_t attributes;
+    xcb_get_geometry_cookie_t geometry;
+    xcb_get_property_cookie_t pid;
+    xcb_get_property_cookie_t types;
+    xcb_get_property_cookie_t states;
+    xcb_get_property_cookie_t netWmName;
+    xcb_get_property_cookie_t wmName;
+    xcb_get_property_cookie_t hints;
+    xcb_get_property_cookie_t transientFor;
+    xcb_get_property_cookie_t windowClass;
+};
+
+//! Waits for a property reply. Errors (such as BadWindow) are discarded instead of being passed to the Xlib error handler.
+static xcb_get_property_reply_t *propertyReply(xcb_connection_t *connection, xcb_get_property_cookie_t cookie)
+{
+    xcb_generic_error_t *error = NULL;
+    xcb_get_property_reply_t *reply = xcb_get_property_reply(connection, cookie, &error);
+    free(error);
+
+    if (reply != NULL && reply->type == XCB_ATOM_NONE) {
+        free(reply);
+        reply = NULL;
+    }
+
+    return reply;
+}
+
+static QList<Atom> atomListFromReply(xcb_get_property_reply_t *reply)
+{
+    QList<Atom> atoms;
+    if (reply != NULL && reply->format == 32) {
+        const xcb_atom_t *data = (const xcb_atom_t *)xcb_get_property_value(reply);
+        int count = xcb_get_property_value_length(reply) / sizeof(xcb_atom_t);
+        for (int i = 0; i < count; i++) {
+            atoms.append(data[i]);
+        }
+    }
+    return atoms;
+}
+
+static quint32 cardinalFromReply(xcb_get_property_reply_t *reply, int index = 0)
+{
+    if (reply != NULL && reply->format == 32 && xcb_get_property_value_length(reply) >= (int)((index + 1) * sizeof(quint32))) {
+        return ((const quint32 *)xcb_get_property_value(reply))[index];
+    }
+    return 0;
+}
+
+static QString stringFromReply(xcb_get_property_reply_t *reply)
+{
+    if (reply == NULL || reply->format != 8) {
+        return QString();
+    }
+
+    const char *data = (const char *)xcb_get_property_value(reply);
+    int length = xcb_get_property_value_length(reply);
+    if (reply->type == XCB_ATOM_STRING) {
+        return QString::fromLatin1(data, length);
+    }
+    return QString::fromUtf8(data, length);
+}
 
 Atom X11Wrapper::XInternAtom(Display *display, const char *atom_name, Bool only_if_exists)
 {
     return ::XInternAtom(display, atom_name, only_if_exists);
 }
 
+Status X11Wrapper::XInternAtoms(Display *display, char **names, int count, Bool only_if_exists, Atom *atoms_return)
+{
+    return ::XInternAtoms(display, names, count, only_if_exists, atoms_return);
+}
+
 int X11Wrapper::XSelectInput(Display *display, Window w, long event_mask)
 {
     return ::XSelectInput(display, w, event_mask);
@@ -85,6 +161,11 @@ int X11Wrapper::XSync(Display *display, Bool discard)
     return ::XSync(display, discard);
 }
 
+int X11Wrapper::XEventsQueued(Display *display, int mode)
+{
+    return ::XEventsQueued(display, mode);
+}
+
 XErrorHandler X11Wrapper::XSetErrorHandler(XErrorHandler handler)
 {
     return ::XSetErrorHandler(handler);
@@ -105,7 +186,250 @@ void X11Wrapper::XDamageSubtract(Display *dpy, Damage damage, XserverRegion repa
     ::XDamageSubtract(dpy, damage, repair, parts);
 }
 
+XserverRegion X11Wrapper::XFixesCreateRegion(Display *dpy, XRectangle *rectangles, int nrectangles)
+{
+    return ::XFixesCreateRegion(dpy, rectangles, nrectangles);
+}
+
+void X11Wrapper::XFixesDestroyRegion(Display *dpy, XserverRegion region)
+{
+    ::XFixesDestroyRegion(dpy, region);
+}
+
+void X11Wrapper::XFixesSetRegion(Display *dpy, XserverRegion region, XRectangle *rectangles, int nrectangles)
+{
+    ::XFixesSetRegion(dpy, region, rectangles, nrectangles);
+}
+
 Status X11Wrapper::XGetTransientForHint(Display *display, Window w, Window *prop_window_return)
 {
     return ::XGetTransientForHint(display, w, prop_window_return);
 }
+
+Pixmap X11Wrapper::XCreatePixmap(Display *display, Drawable d, unsigned int width, unsigned int height, unsigned int depth)
+{
+    return ::XCreatePixmap(display, d, width, height, depth);
+}
+
+XRenderPictFormat *X11Wrapper::XRenderFindVisualFormat(Display *dpy, const Visual *visual)
+{
+    return ::XRenderFindVisualFormat(dpy, visual);
+}
+
+Picture X11Wrapper::XRenderCreatePicture(Display *dpy, Drawable drawable, const XRenderPictFormat *format, unsigned long valuemask, const XRenderPictureAttributes *attributes)
+{
+    return ::XRenderCreatePicture(dpy, drawable, format, valuemask, attributes);
+}
+
+void X11Wrapper::XRenderFreePicture(Display *dpy, Picture picture)
+{
+    ::XRenderFreePicture(dpy, picture);
+}
+
+void X11Wrapper::XRenderSetPictureTransform(Display *dpy, Picture picture, XTransform *transform)
+{
+    ::XRenderSetPictureTransform(dpy, picture, transform);
+}
+
+void X11Wrapper::XRenderSetPictureFilter(Display *dpy, Picture picture, const char *filter, XFixed *params, int nparams)
+{
+    ::XRenderSetPictureFilter(dpy, picture, filter, params, nparams);
+}
+
+void X11Wrapper::XRenderComposite(Display *dpy, int op, Picture src, Picture mask, Picture dst, int src_x, int src_y, int mask_x, int mask_y, int dst_x, int dst_y, unsigned int width, unsigned int height)
+{
+    ::XRenderComposite(dpy, op, src, mask, dst, src_x, src_y, mask_x, mask_y, dst_x, dst_y, width, height);
+}
+
+XVisualInfo *X11Wrapper::XGetVisualInfo(Display *display, long vinfo_mask, XVisualInfo *vinfo_template, int *nitems_return)
+{
+    return ::XGetVisualInfo(display, vinfo_mask, vinfo_template, nitems_return);
+}
+
+Status X11Wrapper::XMatchVisualInfo(Display *display, int screen, int depth, int c_class, XVisualInfo *vinfo_return)
+{
+    return ::XMatchVisualInfo(display, screen, depth, c_class, vinfo_return);
+}
+
+int X11Wrapper::XDestroyImage(XImage *ximage)
+{
+    return ::XDestroyImage(ximage);
+}
+
+Bool X11Wrapper::XShmQueryExtension(Display *display)
+{
+    return ::XShmQueryExtension(display);
+}
+
+XImage *X11Wrapper::XShmCreateImage(Display *display, Visual *visual, unsigned int depth, int format, char *data, XShmSegmentInfo *shminfo, unsigned int width, unsigned int height)
+{
+    return ::XShmCreateImage(display, visual, depth, format, data, shminfo, width, height);
+}
+
+Bool X11Wrapper::XShmAttach(Display *display, XShmSegmentInfo *shminfo)
+{
+    return ::XShmAttach(display, shminfo);
+}
+
+Bool X11Wrapper::XShmDetach(Display *display, XShmSegmentInfo *shminfo)
+{
+    return ::XShmDetach(display, shminfo);
+}
+
+Bool X11Wrapper::XShmGetImage(Display *display, Drawable d, XImage *image, int x, int y, unsigned long plane_mask)
+{
+    return ::XShmGetImage(display, d, image, x, y, plane_mask);
+}
+
+QList<X11Wrapper::WindowProperties> X11Wrapper::scanWindows(Display *display, const QList<Window> &windows, int fields)
+{
+    xcb_connection_t *connection = XGetXCBConnection(display);
+    const xcb_atom_t pidAtom = AtomCache::atom(AtomCache::NetWmPid);
+    const xcb_atom_t typeAtom = AtomCache::atom(AtomCache::NetWmWindowType);
+    const xcb_atom_t stateAtom = AtomCache::atom(AtomCache::NetWmState);
+    const xcb_atom_t nameAtom = AtomCache::atom(AtomCache::NetWmName);
+    const xcb_atom_t utf8StringAtom = AtomCache::atom(AtomCache::Utf8String);
+
+    // Send all the requests for all the windows first...
+    QVector<ScanCookies> cookies(windows.count());
+    for (int i = 0; i < windows.count(); i++) {
+        xcb_window_t window = windows.at(i);
+        ScanCookies &c = cookies[i];
+
+        if (fields & ScanAttributes) {
+            c.attributes = xcb_get_window_attributes(connection, window);
+            c.geometry = xcb_get_geometry(connection, window);
+        }
+        if (fields & ScanPid) {
+            c.pid = xcb_get_property(connection, false, window, pidAtom, XCB_ATOM_CARDINAL, 0, 1);
+        }
+        if (fields & ScanTypes) {
+            c.types = xcb_get_property(connection, false, window, typeAtom, XCB_ATOM_ATOM, 0, 16);
+        }
+        if (fields & ScanStates) {
+            c.states = xcb_get_property(connection, false, window, stateAtom, XCB_ATOM_ATOM, 0, 64);
+        }
+        if (fields & ScanTitle) {
+            c.netWmName = xcb_get_property(connection, false, window, nameAtom, utf8StringAtom, 0, 1024);
+            c.wmName = xcb_get_property(connection, false, window, XCB_ATOM_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, 0, 1024);
+        }
+        if (fields & ScanHints) {
+            c.hints = xcb_get_property(connection, false, window, XCB_ATOM_WM_HINTS, XCB_ATOM_WM_HINTS, 0, 9);
+        }
+        if (fields & ScanTransientFor) {
+            c.transientFor = xcb_get_property(connection, false, window, XCB_ATOM_WM_TRANSIENT_FOR, XCB_ATOM_WINDOW, 0, 1);
+        }
+        if (fields & ScanClass) {
+            c.windowClass = xcb_get_property(connection, false, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 256);
+        }
+    }
+
+    // ...and only then collect the replies
+    QList<WindowProperties> result;
+    for (int i = 0; i < windows.count(); i++) {
+        const ScanCookies &c = cookies.at(i);
+        WindowProperties properties;
+        properties.window = windows.at(i);
+
+        if (fields & ScanAttributes) {
+            // A window destroyed during the scan gives a BadWindow error, which means it's gone
+            xcb_generic_error_t *attributesError = NULL;
+            xcb_generic_error_t *geometryError = NULL;
+            xcb_get_window_attributes_reply_t *attributes = xcb_get_window_attributes_reply(connection, c.attributes, &attributesError);
+            xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(connection, c.geometry, &geometryError);
+            free(attributesError);
+            free(geometryError);
+            properties.exists = attributes != NULL && geometry != NULL &&
+                                attributes->_class == XCB_WINDOW_CLASS_INPUT_OUTPUT &&
+                                geometry->width > 0 && geometry->height > 0;
+            properties.viewable = properties.exists && attributes->map_state != XCB_MAP_STATE_UNMAPPED;
+            free(attributes);
+            free(geometry);
+        }
+        if (fields & ScanPid) {
+            xcb_get_property_reply_t *reply = propertyReply(connection, c.pid);
+            properties.pid = cardinalFromReply(reply);
+            free(reply);
+        }
+        if (fields & ScanTypes) {
+            xcb_get_property_reply_t *reply = propertyReply(connection, c.types);
+            properties.types = atomListFromReply(reply);
+            free(reply);
+        }
+        if (fields & ScanStates) {
+            xcb_get_property_reply_t *reply = propertyReply(connection, c.states);
+            properties.states = atomListFromReply(reply);
+            free(reply);
+        }
+        if (fields & ScanTitle) {
+            xcb_get_property_reply_t *netWmName = propertyReply(connection, c.netWmName);
+            xcb_get_property_reply_t *wmName = propertyReply(connection, c.wmName);
+            properties.title = netWmName != NULL ? stringFromReply(netWmName) : stringFromReply(wmName);
+            free(netWmName);
+            free(wmName);
+        }
+        if (fields & ScanHints) {
+            xcb_get_property_reply_t *reply = propertyReply(connection, c.hints);
+            if (cardinalFromReply(reply, 0) & IconPixmapHint) {
+                properties.iconPixmap = cardinalFromReply(reply, 3);
+            }
+            free(reply);
+        }
+        if (fields & ScanTransientFor) {
+            xcb_get_property_reply_t *reply = propertyReply(connection, c.transientFor);
+            properties.transientFor = cardinalFromReply(reply);
+            free(reply);
+        }
+        if (fields & ScanClass) {
+            // WM_CLASS is two consecutive null-terminated strings: the instance and the class name
+            xcb_get_property_reply_t *reply = propertyReply(connection, c.windowClass);
+            QStringList names = stringFromReply(reply).split(QChar('\0'));
+            properties.windowInstance = names.value(0);
+            properties.windowClass = names.value(1);
+            free(reply);
+        }
+
+        result.append(properties);
+    }
+
+    return result;
+}
+
+X11Wrapper::WindowGeometryRequest X11Wrapper::requestWindowGeometry(Display *display, Window window)
+{
+    xcb_connection_t *connection = XGetXCBConnection(display);
+    WindowGeometryRequest request;
+    request.geometry = xcb_get_geometry(connection, window).sequence;
+    request.attributes = xcb_get_window_attributes(connection, window).sequence;
+    return request;
+}
+
+X11Wrapper::WindowGeometry X11Wrapper::windowGeometryReply(Display *display, const WindowGeometryRequest &request)
+{
+    xcb_connection_t *connection = XGetXCBConnection(display);
+    xcb_get_geometry_cookie_t geometryCookie = { request.geometry };
+    xcb_get_window_attributes_cookie_t attributesCookie = { request.attributes };
+    xcb_generic_error_t *geometryError = NULL;
+    xcb_generic_error_t *attributesError = NULL;
+    xcb_get_geometry_reply_t *geometry = xcb_get_geometry_reply(connection, geometryCookie, &geometryError);
+    xcb_get_window_attributes_reply_t *attributes = xcb_get_window_attributes_reply(connection, attributesCookie, &attributesError);
+    free(geometryError);
+    free(attributesError);
+
+    WindowGeometry windowGeometry;
+    if (geometry != NULL && attributes != NULL) {
+        windowGeometry.size = QSize(geometry->width, geometry->height);
+        windowGeometry.depth = geometry->depth;
+        windowGeometry.visual = attributes->visual;
+    }
+    free(geometry);
+    free(attributes);
+    return windowGeometry;
+}
+
+void X11Wrapper::discardReply(Display *display, const WindowGeometryRequest &request)
+{
+    xcb_connection_t *connection = XGetXCBConnection(display);
+    xcb_discard_reply(connection, request.geometry);
+    xcb_discard_reply(connection, request.attributes);
+}
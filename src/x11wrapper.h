@@ -21,16 +21,110 @@
 #define X11WRAPPER_H_
 
 #include <QPixmap>
+#include <QList>
+#include <QSize>
+#include <QString>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
 #include <X11/extensions/Xcomposite.h>
 #include <X11/extensions/Xdamage.h>
+#include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrender.h>
+#include <X11/extensions/XShm.h>
 
 class X11Wrapper
 {
 public:
+    //! The parts of a window that scanWindows() should fetch
+    enum ScanField {
+        ScanAttributes = 0x01,
+        ScanPid = 0x02,
+        ScanTypes = 0x04,
+        ScanStates = 0x08,
+        ScanTitle = 0x10,
+        ScanHints = 0x20,
+        ScanTransientFor = 0x40,
+        ScanClass = 0x80,
+        ScanAll = 0xff
+    };
+
+    /*!
+     * The properties of a single window as returned by scanWindows().
+     * Only the members requested with the scan fields are filled in.
+     */
+    struct WindowProperties
+    {
+        WindowProperties()
+            : window(0)
+            , exists(false)
+            , viewable(false)
+            , pid(0)
+            , transientFor(0)
+            , iconPixmap(0)
+        {}
+
+        //! The X window ID
+        Window window;
+
+        //! Whether the window exists, is an InputOutput window and has a non-empty size
+        bool exists;
+
+        //! Whether the window exists as above and is mapped
+        bool viewable;
+
+        //! The _NET_WM_PID of the window or 0 if not set
+        int pid;
+
+        //! The _NET_WM_WINDOW_TYPE atoms of the window
+        QList<Atom> types;
+
+        //! The _NET_WM_STATE atoms of the window
+        QList<Atom> states;
+
+        //! The _NET_WM_NAME of the window, or WM_NAME if _NET_WM_NAME is not set
+        QString title;
+
+        //! The WM_TRANSIENT_FOR window or 0 if not set
+        Window transientFor;
+
+        //! The icon pixmap from the WM_HINTS or 0 if not set
+        Pixmap iconPixmap;
+
+        //! The instance name part of WM_CLASS
+        QString windowInstance;
+
+        //! The class name part of WM_CLASS
+        QString windowClass;
+    };
+
+    //! The size, depth and visual of a window as returned by windowGeometryReply()
+    struct WindowGeometry
+    {
+        WindowGeometry()
+            : depth(0)
+            , visual(0)
+        {}
+
+        QSize size;
+        int depth;
+        VisualID visual;
+    };
+
+    //! The requests sent by requestWindowGeometry()
+    struct WindowGeometryRequest
+    {
+        WindowGeometryRequest()
+            : geometry(0)
+            , attributes(0)
+        {}
+
+        unsigned int geometry;
+        unsigned int attributes;
+    };
+
     static Atom XInternAtom(Display *display, const char *atom_name, Bool only_if_exists);
+    static Status XInternAtoms(Display *display, char **names, int count, Bool only_if_exists, Atom *atoms_return);
     static int XSelectInput(Display *display, Window w, long event_mask);
     static Status XGetWindowAttributes(Display *display, Window w, XWindowAttributes *window_attributes_return);
     static int XGetWindowProperty(Display *display, Window w, Atom property, long long_offset, long long_length, Bool del, Atom req_type, Atom *actual_type_return, int *actual_format_return, unsigned long *nitems_return, unsigned long *bytes_after_return, unsigned char **prop_return);
@@ -43,11 +137,65 @@ public:
     static Damage XDamageCreate(Display *dpy, Drawable drawable, int level);
     static void XDamageDestroy(Display *dpy, Damage damage);
     static int XSync(Display *display, Bool discard);
+    static int XEventsQueued(Display *display, int mode);
     static XErrorHandler XSetErrorHandler(XErrorHandler handler);
     static int XChangeProperty(Display *display, Window w, Atom property, Atom type, int format, int mode, unsigned char *data, int nelements);
     static Status XSendEvent(Display *display, Window w, Bool propagate, long event_mask, XEvent *event_send);
     static void XDamageSubtract(Display *dpy, Damage damage, XserverRegion repair, XserverRegion parts);
+    static XserverRegion XFixesCreateRegion(Display *dpy, XRectangle *rectangles, int nrectangles);
+    static void XFixesDestroyRegion(Display *dpy, XserverRegion region);
+    static void XFixesSetRegion(Display *dpy, XserverRegion region, XRectangle *rectangles, int nrectangles);
     static Status XGetTransientForHint(Display *display, Window w, Window *prop_window_return);
+    static Pixmap XCreatePixmap(Display *display, Drawable d, unsigned int width, unsigned int height, unsigned int depth);
+    static XRenderPictFormat *XRenderFindVisualFormat(Display *dpy, const Visual *visual);
+    static Picture XRenderCreatePicture(Display *dpy, Drawable drawable, const XRenderPictFormat *format, unsigned long valuemask, const XRenderPictureAttributes *attributes);
+    static void XRenderFreePicture(Display *dpy, Picture picture);
+    static void XRenderSetPictureTransform(Display *dpy, Picture picture, XTransform *transform);
+    static void XRenderSetPictureFilter(Display *dpy, Picture picture, const char *filter, XFixed *params, int nparams);
+    static void XRenderComposite(Display *dpy, int op, Picture src, Picture mask, Picture dst, int src_x, int src_y, int mask_x, int mask_y, int dst_x, int dst_y, unsigned int width, unsigned int height);
+    static XVisualInfo *XGetVisualInfo(Display *display, long vinfo_mask, XVisualInfo *vinfo_template, int *nitems_return);
+    static Status XMatchVisualInfo(Display *display, int screen, int depth, int c_class, XVisualInfo *vinfo_return);
+    static int XDestroyImage(XImage *ximage);
+    static Bool XShmQueryExtension(Display *display);
+    static XImage *XShmCreateImage(Display *display, Visual *visual, unsigned int depth, int format, char *data, XShmSegmentInfo *shminfo, unsigned int width, unsigned int height);
+    static Bool XShmAttach(Display *display, XShmSegmentInfo *shminfo);
+    static Bool XShmDetach(Display *display, XShmSegmentInfo *shminfo);
+    static Bool XShmGetImage(Display *display, Drawable d, XImage *image, int x, int y, unsigned long plane_mask);
+
+    /*!
+     * Fetches the requested properties of all the given windows. All the
+     * requests for all the windows are sent before any of the replies are
+     * waited for, so the whole scan costs a single round trip to the X server
+     * regardless of the number of windows. Windows that have been destroyed
+     * in the meanwhile are returned with their properties unset.
+     *
+     * \param display the X display
+     * \param windows the windows to scan
+     * \param fields a combination of ScanField values
+     * \return the properties of the windows, in the order of \a windows
+     */
+    static QList<WindowProperties> scanWindows(Display *display, const QList<Window> &windows, int fields = ScanAll);
+
+    /*!
+     * Sends the requests for the size, depth and visual of a window without
+     * waiting for the replies. The replies must be collected with
+     * windowGeometryReply() or thrown away with discardReply().
+     *
+     * \return the sequence numbers of the requests
+     */
+    static WindowGeometryRequest requestWindowGeometry(Display *display, Window window);
+
+    /*!
+     * Waits for the replies of requestWindowGeometry(). Errors (such as
+     * BadWindow) are discarded instead of being passed to the Xlib error
+     * handler.
+     *
+     * \return the geometry of the window; the size is invalid if the window doesn't exist
+     */
+    static WindowGeometry windowGeometryReply(Display *display, const WindowGeometryRequest &request);
+
+    //! Throws away the replies of the requests sent with requestWindowGeometry()
+    static void discardReply(Display *display, const WindowGeometryRequest &request);
 };
 
 #endif /* X11WRAPPER_H_ */
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef XDAMAGELISTENER_H_
+#define XDAMAGELISTENER_H_
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xdamage.h>
+
+/*!
+ * An interface for receiving the XDamageNotify events of a Damage object.
+ * Listeners are registered for a specific Damage handle with
+ * HomeApplication::addXDamageListener() so that each event is delivered
+ * only to the listener owning the damaged drawable.
+ *
+ * The events are only collected by handleXDamageNotify(). Once the last
+ * event of a rendering operation has arrived the listener is scheduled and
+ * processXDamage() is called at most once per frame, which is where the
+ * damage should be subtracted and the repaint requested.
+ */
+class XDamageListener
+{
+public:
+    /*!
+     * Destructor.
+     */
+    virtual ~XDamageListener() {}
+
+    /*!
+     * A handler method for XDamageNotify events.
+     * \param event the XDamageNotify event
+     */
+    virtual void handleXDamageNotify(const XDamageNotifyEvent &event) = 0;
+
+    /*!
+     * Processes the damage collected since the previous call. Called once
+     * per frame after one or more XDamageNotify events have arrived.
+     */
+    virtual void processXDamage() = 0;
+};
+
+#endif /* XDAMAGELISTENER_H_ */
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QTimer>
+#include <QX11Info>
+
+#include "xerrortrap.h"
+#include "x11wrapper.h"
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <stdlib.h>
+
+//! The error code of a trapped request whose error is to be discarded
+static const int IGNORED_REQUEST = -1;
+
+/*!
+ * The X error handler that records the errors of the trapped requests and
+ * passes the rest on to the previously installed handler.
+ */
+class XErrorTrapHandler
+{
+public:
+    static int handleXError(Display *display, XErrorEvent *event)
+    {
+        if (XErrorTrap::instance()->recordError(event->serial, event->error_code)) {
+            return 0;
+        }
+        return previousHandler != NULL ? previousHandler(display, event) : 0;
+    }
+
+    static XErrorHandler previousHandler;
+};
+
+XErrorHandler XErrorTrapHandler::previousHandler = NULL;
+
+XErrorTrap *XErrorTrap::instance()
+{
+    static XErrorTrap xErrorTrap;
+    return &xErrorTrap;
+}
+
+XErrorTrap::XErrorTrap()
+    : sentinelScheduled(false)
+    , sentinelPending(false)
+    , sentinelSequence(0)
+    , sentinelSerial(0)
+    , processedSerial(0)
+{
+    XErrorTrapHandler::previousHandler = X11Wrapper::XSetErrorHandler(XErrorTrapHandler::handleXError);
+}
+
+unsigned long XErrorTrap::trapNextRequest()
+{
+    unsigned long serial = NextRequest(QX11Info::display());
+    trappedRequests.insert(serial, Success);
+
+    // All the requests trapped during this event loop iteration share one sentinel
+    scheduleSentinel();
+
+    return serial;
+}
+
+bool XErrorTrap::isProcessed(unsigned long serial)
+{
+    if (LastKnownRequestProcessed(QX11Info::display()) >= serial) {
+        return true;
+    }
+
+    pollSentinel();
+    if (processedSerial >= serial) {
+        return true;
+    }
+
+    if (!sentinelPending) {
+        // The last sentinel was sent before the request
+        scheduleSentinel();
+    }
+    return false;
+}
+
+int XErrorTrap::takeError(unsigned long serial)
+{
+    return trappedRequests.take(serial);
+}
+
+void XErrorTrap::ignore(unsigned long serial)
+{
+    QHash<unsigned long, int>::iterator request = trappedRequests.find(serial);
+    if (request != trappedRequests.end()) {
+        *request = IGNORED_REQUEST;
+        removeIgnoredRequests();
+    }
+}
+
+void XErrorTrap::sendSentinel()
+{
+    sentinelScheduled = false;
+    if (sentinelPending) {
+        // Another one is sent once the reply to the previous one has arrived
+        return;
+    }
+
+    Display *display = QX11Info::display();
+    xcb_connection_t *connection = XGetXCBConnection(display);
+
+    // xcb flushes the requests buffered by Xlib before sending its own
+    sentinelSerial = NextRequest(display) - 1;
+    sentinelSequence = xcb_get_input_focus(connection).sequence;
+    sentinelPending = true;
+    xcb_flush(connection);
+}
+
+bool XErrorTrap::recordError(unsigned long serial, int errorCode)
+{
+    QHash<unsigned long, int>::iterator request = trappedRequests.find(serial);
+    if (request == trappedRequests.end()) {
+        return false;
+    }
+
+    if (*request == IGNORED_REQUEST) {
+        trappedRequests.erase(request);
+    } else {
+        *request = errorCode;
+    }
+    return true;
+}
+
+void XErrorTrap::pollSentinel()
+{
+    if (!sentinelPending) {
+        return;
+    }
+
+    Display *display = QX11Info::display();
+    void *reply = NULL;
+    xcb_generic_error_t *error = NULL;
+    if (xcb_poll_for_reply(XGetXCBConnection(display), sentinelSequence, &reply, &error)) {
+        free(reply);
+        free(error);
+        sentinelPending = false;
+
+        // Let Xlib pass the errors received before the reply to the error handler
+        X11Wrapper::XEventsQueued(display, QueuedAfterReading);
+        processedSerial = qMax(processedSerial, sentinelSerial);
+        removeIgnoredRequests();
+
+        // Requests may have been trapped while waiting for the reply
+        foreach (unsigned long serial, trappedRequests.keys()) {
+            if (serial > processedSerial) {
+                scheduleSentinel();
+                break;
+            }
+        }
+    }
+}
+
+void XErrorTrap::scheduleSentinel()
+{
+    if (!sentinelScheduled) {
+        sentinelScheduled = true;
+        QTimer::singleShot(0, this, SLOT(sendSentinel()));
+    }
+}
+
+void XErrorTrap::removeIgnoredRequests()
+{
+    unsigned long processed = qMax(processedSerial, (unsigned long)LastKnownRequestProcessed(QX11Info::display()));
+    QHash<unsigned long, int>::iterator request = trappedRequests.begin();
+    while (request != trappedRequests.end()) {
+        if (*request == IGNORED_REQUEST && request.key() <= processed) {
+            request = trappedRequests.erase(request);
+        } else {
+            ++request;
+        }
+    }
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef XERRORTRAP_H
+#define XERRORTRAP_H
+
+#include <QObject>
+#include <QHash>
+
+/*!
+ * Traps the X errors of individual requests by their serial numbers without
+ * waiting for the X server. The errors of a trapped request are recorded
+ * instead of being passed on to the previously installed error handler.
+ *
+ * Whether a request has been processed is found out from the last request
+ * known to be processed by Xlib, or from the reply to a cheap sentinel
+ * request that is sent once after all the requests trapped during an event
+ * loop iteration. Neither ever blocks, so the result of a request is
+ * typically known one frame after it was sent.
+ */
+class XErrorTrap : public QObject
+{
+    Q_OBJECT
+
+public:
+    //! Returns the XErrorTrap instance
+    static XErrorTrap *instance();
+
+    /*!
+     * Starts trapping the errors of the next request. Call right before
+     * sending the request.
+     *
+     * \return the serial number of the request
+     */
+    unsigned long trapNextRequest();
+
+    /*!
+     * Returns whether the X server has processed a trapped request and its
+     * possible error has been received. Never blocks.
+     *
+     * \param serial the serial number of the request
+     */
+    bool isProcessed(unsigned long serial);
+
+    /*!
+     * Stops trapping a processed request.
+     *
+     * \param serial the serial number of the request
+     * \return the error code of the request or Success if there was no error
+     */
+    int takeError(unsigned long serial);
+
+    /*!
+     * Stops waiting for a trapped request. The possible error of the
+     * request is discarded.
+     *
+     * \param serial the serial number of the request
+     */
+    void ignore(unsigned long serial);
+
+private slots:
+    //! Sends a request whose reply tells that the requests sent before it have been processed
+    void sendSentinel();
+
+private:
+    XErrorTrap();
+
+    //! Records the error of a trapped request. Returns false if the request is not trapped.
+    bool recordError(unsigned long serial, int errorCode);
+
+    //! Checks whether the reply to the sentinel request has arrived
+    void pollSentinel();
+
+    //! Schedules sending a sentinel request when the event loop is next entered
+    void scheduleSentinel();
+
+    //! Removes the ignored requests that have been processed
+    void removeIgnoredRequests();
+
+    //! The error codes of the trapped requests by their serial numbers
+    QHash<unsigned long, int> trappedRequests;
+
+    //! Whether a sentinel request has been scheduled to be sent
+    bool sentinelScheduled;
+
+    //! Whether a sentinel request has been sent but not replied to yet
+    bool sentinelPending;
+
+    //! The sequence number of the sentinel request
+    unsigned int sentinelSequence;
+
+    //! The serial number of the last request sent before the sentinel
+    unsigned long sentinelSerial;
+
+    //! The serial number of the last request known to be processed through the sentinel
+    unsigned long processedSerial;
+
+    friend class XErrorTrapHandler;
+};
+
+#endif // XERRORTRAP_H
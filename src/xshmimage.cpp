@@ -0,0 +1,155 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#include <QX11Info>
+
+#include "xshmimage.h"
+#include "x11wrapper.h"
+#include "xerrortrap.h"
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+struct XShmImage::Private
+{
+    Private()
+        : xImage(NULL)
+        , depth(0)
+        , attached(false)
+    {
+        shmInfo.shmid = -1;
+        shmInfo.shmaddr = NULL;
+    }
+
+    XShmSegmentInfo shmInfo;
+    XImage *xImage;
+    QImage image;
+    QSize size;
+    int depth;
+
+    //! Whether the segment has been attached to the X server
+    bool attached;
+};
+
+//! Whether MIT-SHM can be used; -1 until it has been checked
+static int supported = -1;
+
+bool XShmImage::isSupported()
+{
+    if (supported == -1) {
+        supported = qgetenv("LIPSTICK_NO_SHM").isEmpty() && X11Wrapper::XShmQueryExtension(QX11Info::display());
+    }
+
+    return supported;
+}
+
+XShmImage::XShmImage(const QSize &size, int depth)
+    : d(new Private)
+{
+    d->size = size;
+    d->depth = depth;
+    if (!isSupported() || size.isEmpty()) {
+        return;
+    }
+
+    Display *display = QX11Info::display();
+    XVisualInfo visualInfo;
+    if (!X11Wrapper::XMatchVisualInfo(display, QX11Info::appScreen(), depth, TrueColor, &visualInfo)) {
+        return;
+    }
+
+    d->xImage = X11Wrapper::XShmCreateImage(display, visualInfo.visual, depth, ZPixmap, NULL, &d->shmInfo, size.width(), size.height());
+    if (d->xImage == NULL) {
+        return;
+    }
+
+    // Only 32 bits per pixel can be used as a QImage without converting
+    if (d->xImage->bits_per_pixel == 32) {
+        d->shmInfo.shmid = shmget(IPC_PRIVATE, d->xImage->bytes_per_line * d->xImage->height, IPC_CREAT | 0600);
+    }
+    if (d->shmInfo.shmid < 0) {
+        X11Wrapper::XDestroyImage(d->xImage);
+        d->xImage = NULL;
+        return;
+    }
+
+    d->shmInfo.shmaddr = d->xImage->data = (char *)shmat(d->shmInfo.shmid, NULL, 0);
+    if (d->shmInfo.shmaddr == (char *)-1) {
+        shmctl(d->shmInfo.shmid, IPC_RMID, NULL);
+        d->xImage->data = NULL;
+        X11Wrapper::XDestroyImage(d->xImage);
+        d->xImage = NULL;
+        return;
+    }
+
+    // A server that can't access the segment (such as a remote one) fails
+    // the attach with an error, so the attach is trapped and waited for once
+    d->shmInfo.readOnly = False;
+    XErrorTrap *xErrorTrap = XErrorTrap::instance();
+    unsigned long request = xErrorTrap->trapNextRequest();
+    X11Wrapper::XShmAttach(display, &d->shmInfo);
+    X11Wrapper::XSync(display, False);
+    d->attached = xErrorTrap->takeError(request) == Success;
+
+    // Once the server has attached the segment it can be marked to be
+    // removed; it then goes away when both sides have detached it
+    shmctl(d->shmInfo.shmid, IPC_RMID, NULL);
+
+    if (!d->attached) {
+        // The other images would fail in the same way
+        supported = 0;
+        shmdt(d->shmInfo.shmaddr);
+        d->xImage->data = NULL;
+        X11Wrapper::XDestroyImage(d->xImage);
+        d->xImage = NULL;
+    }
+}
+
+XShmImage::~XShmImage()
+{
+    if (d->xImage != NULL) {
+        X11Wrapper::XShmDetach(QX11Info::display(), &d->shmInfo);
+
+        // The image data is the shared memory segment which is released separately
+        d->xImage->data = NULL;
+        X11Wrapper::XDestroyImage(d->xImage);
+        shmdt(d->shmInfo.shmaddr);
+    }
+    delete d;
+}
+
+bool XShmImage::isValid() const
+{
+    return d->xImage != NULL && d->attached;
+}
+
+QSize XShmImage::size() const
+{
+    return d->size;
+}
+
+int XShmImage::depth() const
+{
+    return d->depth;
+}
+
+bool XShmImage::read(Qt::HANDLE drawable)
+{
+    if (!isValid() || !X11Wrapper::XShmGetImage(QX11Info::display(), drawable, d->xImage, 0, 0, AllPlanes)) {
+        return false;
+    }
+
+    // A new QImage so that any textures made from the previous contents are not reused
+    d->image = QImage((const uchar *)d->xImage->data, d->size.width(), d->size.height(), d->xImage->bytes_per_line,
+                      d->depth == 32 ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+    return true;
+}
+
+QImage XShmImage::image() const
+{
+    return d->image;
+}
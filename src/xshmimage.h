@@ -0,0 +1,72 @@
+/*
+ * Copyright 2011 Intel Corporation.
+ *
+ * This program is licensed under the terms and conditions of the
+ * Apache License, version 2.0.  The full text of the Apache License is at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ */
+
+#ifndef XSHMIMAGE_H
+#define XSHMIMAGE_H
+
+#include <QImage>
+#include <QSize>
+
+/*!
+ * A client side image in a MIT-SHM shared memory segment. The contents of
+ * an X drawable are read into the segment by the X server with
+ * XShmGetImage() so that they don't travel through the X protocol stream.
+ * The segment is allocated once and reused for every read.
+ *
+ * The extension can be disabled by setting the LIPSTICK_NO_SHM environment
+ * variable, in which case isSupported() returns false. It is disabled too
+ * if the X server fails to attach a segment, as a remote server does.
+ */
+class XShmImage
+{
+public:
+    //! Returns whether the MIT-SHM extension is available
+    static bool isSupported();
+
+    /*!
+     * Creates a shared memory image.
+     *
+     * \param size the size of the image
+     * \param depth the depth of the drawables to read
+     */
+    XShmImage(const QSize &size, int depth);
+
+    /*!
+     * Destroys the image and releases the shared memory segment.
+     */
+    ~XShmImage();
+
+    //! Returns whether the shared memory segment could be set up
+    bool isValid() const;
+
+    //! Returns the size of the image
+    QSize size() const;
+
+    //! Returns the depth of the image
+    int depth() const;
+
+    /*!
+     * Reads the contents of an X drawable of the size and depth of the image.
+     *
+     * \param drawable the drawable to read
+     * \return true if the contents were read
+     */
+    bool read(Qt::HANDLE drawable);
+
+    /*!
+     * Returns the contents read last. The image refers to the shared memory
+     * directly and is only valid until the next read.
+     */
+    QImage image() const;
+
+private:
+    struct Private;
+    Private * const d;
+};
+
+#endif // XSHMIMAGE_H